@@ -97,6 +97,40 @@ int re_sdprintf(char **strp, const char *fmt, ...);
 /* Regular expressions */
 int re_regex(const char *ptr, size_t len, const char *expr, ...);
 
+enum {
+	RE_REGEX_MAXOPS = 32,
+	RE_REGEX_MAXCLS = 16,
+};
+
+/** Compiled regular expression operation */
+struct re_regex_op {
+	uint32_t nmin;     /**< Minimum number of matches (class) */
+	uint32_t nmax;     /**< Maximum number of matches (class) */
+	uint8_t ch;        /**< Lower-case character (literal)    */
+	uint8_t cls;       /**< Character class index             */
+	bool iscls;        /**< True for character class          */
+	bool qesc;         /**< Quote escape (~)                  */
+};
+
+/** Compiled regular expression, see re_regex() for syntax */
+struct re_regex {
+	const char *expr;                          /**< Expression      */
+	struct re_regex_op opv[RE_REGEX_MAXOPS];   /**< Operations      */
+	uint8_t clsv[RE_REGEX_MAXCLS][32];         /**< Class bitmaps   */
+	uint32_t opc;                              /**< Operation count */
+	uint32_t clsc;                             /**< Class count     */
+	int err;                                   /**< Compile error   */
+	bool compiled;                             /**< Compiled flag   */
+};
+
+/** Static initialiser, compile with re_regex_compile() before use */
+#define RE_REGEX_INIT(expr) {(expr), {{0,0,0,0,false,false}}, {{0}}, \
+			     0, 0, 0, false}
+
+int re_regex_compile(struct re_regex *rx, const char *expr);
+int re_regex_exec(const struct re_regex *rx, const char *ptr, size_t len,
+		  ...);
+
 
 /* Character functions */
 uint8_t ch_hex(char ch);
@@ -6,6 +6,12 @@
 struct jbuf;
 struct rtp_header;
 
+/** Jitter buffer type */
+enum jbuf_type {
+	JBUF_FIXED = 0,  /**< Fixed delay, released by frame count    */
+	JBUF_ADAPTIVE,   /**< Adaptive delay, driven by RTP timestamps */
+};
+
 /** Jitter buffer statistics */
 struct jbuf_stat {
 	uint32_t n_put;        /**< Number of frames put into jitter buffer */
@@ -17,10 +23,15 @@ struct jbuf_stat {
 	uint32_t n_overflow;   /**< Number of overflows                     */
 	uint32_t n_underflow;  /**< Number of underflows                    */
 	uint32_t n_flush;      /**< Number of times jitter buffer flushed   */
+	uint32_t c_delay;      /**< Current delay in [ms]                   */
+	uint32_t t_delay;      /**< Target delay in [ms] (adaptive)         */
+	uint32_t jitter;       /**< Inter-arrival jitter in [ms] (adaptive) */
 };
 
 
 int  jbuf_alloc(struct jbuf **jbp, uint32_t min, uint32_t max);
+int  jbuf_set_type(struct jbuf *jb, enum jbuf_type jbtype);
+int  jbuf_set_srate(struct jbuf *jb, uint32_t srate);
 int  jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem);
 int  jbuf_get(struct jbuf *jb, struct rtp_header *hdr, void **mem);
 void jbuf_flush(struct jbuf *jb);
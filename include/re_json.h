@@ -23,6 +23,7 @@ struct json_value {
 };
 
 struct json_handlers;
+struct mbuf;
 
 typedef int (json_object_entry_h)(const char *name,
 				  const struct json_value *value, void *arg);
@@ -48,3 +49,33 @@ int json_decode(const char *str, size_t len, unsigned maxdepth,
 int json_decode_odict(struct odict **op, uint32_t hash_size, const char *str,
 		      size_t len, unsigned maxdepth);
 int json_encode_odict(struct re_printf *pf, const struct odict *o);
+int json_encode_odict_mbuf(struct mbuf *mb, const struct odict *o);
+
+
+/* Streaming decoder */
+
+enum json_event {
+	JSON_EV_OBJECT_START,
+	JSON_EV_OBJECT_END,
+	JSON_EV_ARRAY_START,
+	JSON_EV_ARRAY_END,
+	JSON_EV_KEY,
+	JSON_EV_STRING,
+	JSON_EV_NUMBER,
+	JSON_EV_TRUE,
+	JSON_EV_FALSE,
+	JSON_EV_NULL,
+};
+
+struct json_stream;
+
+typedef int (json_event_h)(enum json_event ev, const struct pl *pl,
+			   void *arg);
+
+int  json_stream_alloc(struct json_stream **jsp, unsigned maxdepth,
+		       json_event_h *eh, void *arg);
+int  json_stream_feed(struct json_stream *js, const char *str, size_t len);
+int  json_stream_decode(struct json_stream *js, struct mbuf *mb);
+int  json_stream_end(struct json_stream *js);
+void json_stream_reset(struct json_stream *js);
+unsigned json_stream_depth(const struct json_stream *js);
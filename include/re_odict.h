@@ -16,7 +16,12 @@ enum odict_type {
 
 struct odict {
 	struct list lst;
-	struct hash *ht;
+	struct hash *ht;       /* NULL until more than ODICT_HASH_MIN entries */
+	uint32_t hash_size;
+};
+
+enum {
+	ODICT_HASH_MIN = 8,
 };
 
 struct odict_entry {
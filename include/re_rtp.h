@@ -31,6 +31,21 @@ struct rtp_header {
 	} x;
 };
 
+/** RTP Header Extensions (RFC 8285) */
+enum {
+	RTPEXT_TYPE_ONEBYTE = 0xbede,  /**< One-byte header type          */
+	RTPEXT_TYPE_TWOBYTE = 0x1000,  /**< Two-byte header type          */
+	RTPEXT_TYPE_MASK    = 0xfff0,  /**< Mask for two-byte header type */
+	RTPEXT_LEN_MAX      = 255,     /**< Maximum element data length   */
+};
+
+/** Defines an RTP header extension element */
+struct rtpext {
+	uint8_t id;     /**< Local identifier              */
+	size_t len;     /**< Length of element data        */
+	uint8_t *data;  /**< Element data, in packet buffer */
+};
+
 /** RTCP Packet Types */
 enum rtcp_type {
 	RTCP_FIR   = 192,  /**< Full INTRA-frame Request (RFC 2032)    */
@@ -61,7 +76,8 @@ enum rtcp_sdes_type {
 
 /** Transport Layer Feedback Messages */
 enum rtcp_rtpfb {
-	RTCP_RTPFB_GNACK = 1  /**< Generic NACK */
+	RTCP_RTPFB_GNACK = 1,  /**< Generic NACK                   */
+	RTCP_RTPFB_TWCC  = 15, /**< Transport-wide Congestion Ctrl */
 };
 
 /** Payload-Specific Feedback Messages */
@@ -167,6 +183,15 @@ struct rtcp_msg {
 					uint8_t picid;
 				} *sliv;
 				struct mbuf *afb;
+				/** Transport-wide CC feedback */
+				struct twcc {
+					uint16_t seq;     /**< Base seq.     */
+					uint16_t count;   /**< Status count  */
+					int32_t reftime;  /**< In 64ms units */
+					uint8_t fbcount;  /**< Feedback no.  */
+					struct mbuf *chunks;  /**< Chunks    */
+					struct mbuf *deltas;  /**< Deltas    */
+				} *twcc;
 				void *p;
 			} fci;
 		} fb;
@@ -188,14 +213,33 @@ struct rtcp_stats {
 	uint32_t rtt;           /**< Current Round-Trip Time in [us] */
 };
 
+/** RTP Retransmission Statistics */
+struct rtp_rtx_stat {
+	uint32_t n_nack;    /**< Number of packets reported lost    */
+	uint32_t n_served;  /**< Number of packets retransmitted    */
+	uint32_t n_miss;    /**< Number of packets not in history   */
+	size_t mem;         /**< Bytes used by the send history     */
+};
+
+/** RTCP Report Statistics */
+struct rtcp_report_stats {
+	uint32_t n_reports;    /**< Number of reports sent            */
+	uint32_t n_sdes;       /**< Number of reports with SDES       */
+	uint64_t bytes;        /**< Report bytes sent                 */
+	uint64_t bytes_saved;  /**< Bytes saved by reduced-size RTCP  */
+};
+
 struct sa;
 struct re_printf;
 struct rtp_sock;
+struct rtcp_sched;
 
 typedef void (rtp_recv_h)(const struct sa *src, const struct rtp_header *hdr,
 			  struct mbuf *mb, void *arg);
 typedef void (rtcp_recv_h)(const struct sa *src, struct rtcp_msg *msg,
 			   void *arg);
+typedef void (rtcp_twcc_h)(uint16_t seq, bool received, int64_t arrival,
+			   void *arg);
 
 /* RTP api */
 int   rtp_alloc(struct rtp_sock **rsp);
@@ -213,6 +257,23 @@ int   rtp_debug(struct re_printf *pf, const struct rtp_sock *rs);
 void *rtp_sock(const struct rtp_sock *rs);
 uint32_t rtp_sess_ssrc(const struct rtp_sock *rs);
 const struct sa *rtp_local(const struct rtp_sock *rs);
+void  rtp_jitter_calc(int *transit, uint32_t *jitter, uint32_t rtp_ts,
+		      uint32_t arrival);
+int   rtp_rtx_enable(struct rtp_sock *rs, uint32_t npkt, size_t maxmem);
+int   rtp_rtx_set_stream(struct rtp_sock *rs, bool enabled, uint8_t pt,
+			 uint32_t ssrc);
+int   rtp_rtx_stats(const struct rtp_sock *rs, struct rtp_rtx_stat *stat);
+int   rtp_twcc_enable(struct rtp_sock *rs, uint8_t extid, uint32_t interval);
+
+/* RTP header extension api */
+int   rtpext_decode(struct rtpext *extv, size_t *extc,
+		    const struct rtp_header *hdr, const struct mbuf *mb);
+int   rtpext_find(struct rtpext *ext, const struct rtp_header *hdr,
+		  const struct mbuf *mb, uint8_t id);
+int   rtpext_hdr_encode(struct mbuf *mb, uint16_t type);
+int   rtpext_encode(struct mbuf *mb, uint16_t type, uint8_t id, size_t len,
+		    const uint8_t *data);
+int   rtpext_hdr_update(struct mbuf *mb, size_t start);
 
 /* RTCP session api */
 void  rtcp_start(struct rtp_sock *rs, const char *cname,
@@ -229,11 +290,19 @@ int   rtcp_send_pli(struct rtp_sock *rs, uint32_t fb_ssrc);
 int   rtcp_debug(struct re_printf *pf, const struct rtp_sock *rs);
 void *rtcp_sock(const struct rtp_sock *rs);
 int   rtcp_stats(struct rtp_sock *rs, uint32_t ssrc, struct rtcp_stats *stats);
+void  rtcp_enable_rsize(struct rtp_sock *rs, bool enabled);
+int   rtcp_report_stats(const struct rtp_sock *rs,
+			struct rtcp_report_stats *stats);
+int   rtcp_set_sched(struct rtp_sock *rs, struct rtcp_sched *sched);
+
+/* RTCP scheduler api */
+int   rtcp_sched_alloc(struct rtcp_sched **schedp, uint32_t tick);
 
 /* RTCP utils */
 int   rtcp_encode(struct mbuf *mb, enum rtcp_type type, uint32_t count, ...);
 int   rtcp_decode(struct rtcp_msg **msgp, struct mbuf *mb);
 int   rtcp_msg_print(struct re_printf *pf, const struct rtcp_msg *msg);
 int   rtcp_sdes_encode(struct mbuf *mb, uint32_t src, uint32_t itemc, ...);
+int   rtcp_twcc_apply(const struct twcc *twcc, rtcp_twcc_h *h, void *arg);
 const char *rtcp_type_name(enum rtcp_type type);
 const char *rtcp_sdes_name(enum rtcp_sdes_type sdes);
@@ -32,3 +32,7 @@ void SHA1_Update(SHA1_CTX* context, const void *p, size_t len);
 void SHA1_Final(uint8_t digest[SHA1_DIGEST_SIZE], SHA1_CTX* context);
 
 #endif
+
+
+void sha1_multi(uint8_t * const mdv[], const uint8_t * const datav[],
+		const size_t lenv[], size_t n);
@@ -223,6 +223,7 @@ struct sip_contact {
 
 struct sip;
 struct sip_lsnr;
+struct sip_shards;
 struct sip_request;
 struct sip_strans;
 struct sip_auth;
@@ -250,6 +251,14 @@ int  sip_alloc(struct sip **sipp, struct dnsc *dnsc, uint32_t ctsz,
 void sip_close(struct sip *sip, bool force);
 int  sip_listen(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
 		sip_msg_h *msgh, void *arg);
+int  sip_listen_method(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
+		       const char *met, sip_msg_h *msgh, void *arg);
+int  sip_set_dialog_cache(struct sip *sip, uint32_t htsize);
+int  sip_set_overload(struct sip *sip, uint32_t lag_max, uint32_t strans_max,
+		      uint32_t retry_after);
+int  sip_shards_alloc(struct sip_shards **grpp, uint32_t n);
+int  sip_shard_attach(struct sip *sip, struct sip_shards *grp, uint32_t idx);
+bool sip_shard_owns(const struct sip *sip, const struct pl *callid);
 int  sip_debug(struct re_printf *pf, const struct sip *sip);
 int  sip_send(struct sip *sip, void *sock, enum sip_transp tp,
 	      const struct sa *dst, struct mbuf *mb);
@@ -303,6 +312,7 @@ int  sip_replyf(struct sip *sip, const struct sip_msg *msg, uint16_t scode,
 int  sip_reply(struct sip *sip, const struct sip_msg *msg, uint16_t scode,
 	       const char *reason);
 void sip_reply_addr(struct sa *addr, const struct sip_msg *msg, bool rport);
+int  sip_set_reply_headers(struct sip *sip, const char *hdrs, ...);
 
 
 /* auth */
@@ -324,6 +334,10 @@ int  sip_dialog_alloc(struct sip_dialog **dlgp,
 		      const char *uri, const char *to_uri,
 		      const char *from_name, const char *from_uri,
 		      const char *routev[], uint32_t routec);
+int  sip_dialog_alloc_shard(struct sip_dialog **dlgp, const struct sip *sip,
+			    const char *uri, const char *to_uri,
+			    const char *from_name, const char *from_uri,
+			    const char *routev[], uint32_t routec);
 int  sip_dialog_accept(struct sip_dialog **dlgp, const struct sip_msg *msg);
 int  sip_dialog_create(struct sip_dialog *dlg, const struct sip_msg *msg);
 int  sip_dialog_fork(struct sip_dialog **dlgp, struct sip_dialog *odlg,
@@ -164,10 +164,34 @@ struct stun_conf {
 };
 
 
+/** Defines a view of a STUN Binding message, pointing into the buffer */
+struct stun_view {
+	uint8_t *buf;              /**< Start of the message              */
+	uint16_t cls;              /**< STUN Message class                */
+	uint16_t len;              /**< Message length                    */
+	const uint8_t *tid;        /**< Transaction ID                    */
+	const char *username;      /**< USERNAME value, not terminated    */
+	size_t username_len;       /**< Length of USERNAME value          */
+	const uint8_t *mi;         /**< MESSAGE-INTEGRITY value or NULL   */
+	size_t mi_pos;             /**< Offset of MESSAGE-INTEGRITY       */
+	const uint8_t *fp;         /**< FINGERPRINT value or NULL         */
+	size_t fp_pos;             /**< Offset of FINGERPRINT             */
+	struct sa mapped_addr;     /**< XOR-MAPPED-ADDRESS value          */
+	uint64_t tiebrk;           /**< ICE-CONTROLLED/ING tie-breaker    */
+	uint32_t priority;         /**< PRIORITY value                    */
+	uint16_t scode;            /**< ERROR-CODE status code            */
+	bool prio;                 /**< PRIORITY is present               */
+	bool use_cand;             /**< USE-CANDIDATE is present          */
+	bool controlled;           /**< ICE-CONTROLLED is present         */
+	bool controlling;          /**< ICE-CONTROLLING is present        */
+};
+
+
 extern const char *stun_software;
 struct stun;
 struct stun_msg;
 struct stun_ctrans;
+struct hmac;
 
 typedef void(stun_resp_h)(int err, uint16_t scode, const char *reason,
 			  const struct stun_msg *msg, void *arg);
@@ -195,6 +219,10 @@ int  stun_ereply(int proto, void *sock, const struct sa *dst, size_t presz,
 		 const struct stun_msg *req, uint16_t scode,
 		 const char *reason, const uint8_t *key, size_t keylen,
 		 bool fp, uint32_t attrc, ...);
+int  stun_request_hmac(struct stun_ctrans **ctp, struct stun *stun, int proto,
+		       void *sock, const struct sa *dst, size_t presz,
+		       uint16_t method, struct hmac *hmac, bool fp,
+		       stun_resp_h *resph, void *arg, uint32_t attrc, ...);
 int  stun_indication(int proto, void *sock, const struct sa *dst, size_t presz,
 		     uint16_t method, const uint8_t *key, size_t keylen,
 		     bool fp, uint32_t attrc, ...);
@@ -207,6 +235,14 @@ int  stun_msg_encode(struct mbuf *mb, uint16_t method, uint8_t cls,
 		     const uint8_t *tid, const struct stun_errcode *ec,
 		     const uint8_t *key, size_t keylen, bool fp,
 		     uint8_t padding, uint32_t attrc, ...);
+int  stun_msg_vencode_hmac(struct mbuf *mb, uint16_t method, uint8_t cls,
+			   const uint8_t *tid, const struct stun_errcode *ec,
+			   struct hmac *hmac, bool fp, uint8_t padding,
+			   uint32_t attrc, va_list ap);
+int  stun_msg_encode_hmac(struct mbuf *mb, uint16_t method, uint8_t cls,
+			  const uint8_t *tid, const struct stun_errcode *ec,
+			  struct hmac *hmac, bool fp, uint8_t padding,
+			  uint32_t attrc, ...);
 int  stun_msg_decode(struct stun_msg **msgpp, struct mbuf *mb,
 		     struct stun_unknown_attr *ua);
 uint16_t stun_msg_type(const struct stun_msg *msg);
@@ -219,9 +255,16 @@ struct stun_attr *stun_msg_attr_apply(const struct stun_msg *msg,
 				      stun_attr_h *h, void *arg);
 int  stun_msg_chk_mi(const struct stun_msg *msg, const uint8_t *key,
 		     size_t keylen);
+int  stun_msg_chk_hmac(const struct stun_msg *msg, struct hmac *hmac);
 int  stun_msg_chk_fingerprint(const struct stun_msg *msg);
 void stun_msg_dump(const struct stun_msg *msg);
 
+int  stun_view_decode(struct stun_view *v, struct mbuf *mb);
+int  stun_view_chk_mi(const struct stun_view *v, const uint8_t *key,
+		      size_t keylen);
+int  stun_view_chk_hmac(const struct stun_view *v, struct hmac *hmac);
+int  stun_view_chk_fingerprint(const struct stun_view *v);
+
 const char *stun_class_name(uint16_t cls);
 const char *stun_method_name(uint16_t method);
 const char *stun_attr_name(uint16_t type);
@@ -31,3 +31,39 @@ int turnc_add_perm(struct turnc *turnc, const struct sa *peer,
 		   turnc_perm_h *ph, void *arg);
 int turnc_add_chan(struct turnc *turnc, const struct sa *peer,
 		   turnc_chan_h *ch, void *arg);
+void turnc_set_autochan(struct turnc *turnc, uint32_t threshold);
+
+
+/* TURN Server */
+
+/** TURN Server statistics */
+struct turns_stat {
+	uint64_t n_alloc;     /**< Number of allocations created       */
+	uint64_t n_chandata;  /**< Number of ChannelData relayed       */
+	uint64_t n_ind;       /**< Number of indications relayed       */
+	uint64_t n_drop;      /**< Number of packets dropped           */
+};
+
+/**
+ * Defines the TURN Server authentication handler
+ *
+ * @param ha1      Long-term credential key MD5(username:realm:password),
+ *                 set on return
+ * @param username Username of the request
+ * @param realm    Realm of the TURN Server
+ * @param arg      Handler argument
+ *
+ * @return 0 if the user is known, otherwise errorcode
+ */
+typedef int(turns_auth_h)(uint8_t *ha1, const char *username,
+			  const char *realm, void *arg);
+
+struct turns;
+struct re_printf;
+
+int  turns_alloc(struct turns **tsp, const struct sa *laddr,
+		 const struct sa *relay, const char *realm,
+		 turns_auth_h *authh, void *arg);
+int  turns_local_get(const struct turns *ts, struct sa *laddr);
+void turns_stats(const struct turns *ts, struct turns_stat *stat);
+int  turns_debug(struct re_printf *pf, const struct turns *ts);
@@ -5,7 +5,12 @@
  */
 #include <re_types.h>
 #include <re_fmt.h>
+#include <re_mbuf.h>
 #include <re_base64.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define BASE64_SSSE3 1
+#endif
 
 
 static const char b64_table[65] =
@@ -14,6 +19,126 @@ static const char b64_table[65] =
 	"0123456789+/";
 
 
+#ifdef BASE64_SSSE3
+/*
+ * Vectorised encoding and decoding of 16 characters at a time, based
+ * on the algorithms by Wojciech Mula and Alfred Klomp.
+ */
+
+
+static bool have_ssse3(void)
+{
+	static int have = -1;
+
+	if (have < 0) {
+		__builtin_cpu_init();
+		have = __builtin_cpu_supports("ssse3");
+	}
+
+	return have > 0;
+}
+
+
+/* Encode 12 bytes per iteration, reads 16 bytes */
+__attribute__((target("ssse3")))
+static size_t encode_ssse3(const uint8_t *in, size_t ilen, char *out)
+{
+	const __m128i shuf = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+					  4, 5, 3, 4, 1, 2, 0, 1);
+	const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+					  -4, -4, -4, -4, -19, -16, 0, 0);
+	size_t n = 0;
+
+	while (ilen - n >= 16) {
+
+		__m128i v, t0, t1, idx;
+
+		v = _mm_loadu_si128((const __m128i *)(const void *)(in + n));
+		v = _mm_shuffle_epi8(v, shuf);
+
+		/* split 3 bytes into 4 x 6 bits */
+		t0 = _mm_mulhi_epu16(_mm_and_si128(v,
+						   _mm_set1_epi32(0x0fc0fc00)),
+				     _mm_set1_epi32(0x04000040));
+		t1 = _mm_mullo_epi16(_mm_and_si128(v,
+						   _mm_set1_epi32(0x003f03f0)),
+				     _mm_set1_epi32(0x01000010));
+		v = _mm_or_si128(t0, t1);
+
+		/* translate 6-bit values to ASCII */
+		idx = _mm_subs_epu8(v, _mm_set1_epi8(51));
+		idx = _mm_sub_epi8(idx, _mm_cmpgt_epi8(v, _mm_set1_epi8(25)));
+		v = _mm_add_epi8(v, _mm_shuffle_epi8(lut, idx));
+
+		_mm_storeu_si128((__m128i *)(void *)out, v);
+
+		out += 16;
+		n += 12;
+	}
+
+	return n;
+}
+
+
+/*
+ * Decode 16 characters per iteration, writes 16 bytes of which 12 are
+ * valid. Stops at the first block with characters outside the alphabet.
+ */
+__attribute__((target("ssse3")))
+static size_t decode_ssse3(const char *in, size_t ilen, uint8_t *out)
+{
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11,
+					     0x11, 0x11, 0x11, 0x11,
+					     0x11, 0x11, 0x13, 0x1a,
+					     0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02,
+					     0x04, 0x08, 0x04, 0x08,
+					     0x10, 0x10, 0x10, 0x10,
+					     0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65,
+					       -71, -71, 0, 0, 0, 0,
+					       0, 0, 0, 0);
+	const __m128i shuf = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+					   14, 13, 12, -1, -1, -1, -1);
+	const __m128i mask_2f = _mm_set1_epi8(0x2f);
+	size_t n = 0;
+
+	/* the last quad, which may be padded, is left to the caller */
+	while (ilen - n >= 24) {
+
+		__m128i v, hi_nib, lo_nib, hi, lo, eq, roll;
+
+		v = _mm_loadu_si128((const __m128i *)(const void *)(in + n));
+
+		hi_nib = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+		lo_nib = _mm_and_si128(v, mask_2f);
+		hi = _mm_shuffle_epi8(lut_hi, hi_nib);
+		lo = _mm_shuffle_epi8(lut_lo, lo_nib);
+
+		if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+						     _mm_setzero_si128())))
+			break;
+
+		eq = _mm_cmpeq_epi8(v, mask_2f);
+		roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq, hi_nib));
+		v = _mm_add_epi8(v, roll);
+
+		/* pack 4 x 6 bits into 3 bytes */
+		v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+		v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+		v = _mm_shuffle_epi8(v, shuf);
+
+		_mm_storeu_si128((__m128i *)(void *)out, v);
+
+		out += 12;
+		n += 16;
+	}
+
+	return n;
+}
+#endif
+
+
 /**
  * Base-64 encode a buffer
  *
@@ -28,6 +153,7 @@ int base64_encode(const uint8_t *in, size_t ilen, char *out, size_t *olen)
 {
 	const uint8_t *in_end = in + ilen;
 	const char *o = out;
+	uint32_t v;
 
 	if (!in || !out || !olen)
 		return EINVAL;
@@ -35,28 +161,36 @@ int base64_encode(const uint8_t *in, size_t ilen, char *out, size_t *olen)
 	if (*olen < 4 * ((ilen+2)/3))
 		return EOVERFLOW;
 
-	for (; in < in_end; ) {
-		uint32_t v;
-		int pad = 0;
+#ifdef BASE64_SSSE3
+	if (ilen >= 16 && have_ssse3()) {
 
-		v  = *in++ << 16;
-		if (in < in_end) {
-			v |= *in++ << 8;
-		}
-		else {
-			++pad;
-		}
-		if (in < in_end) {
-			v |= *in++ << 0;
-		}
-		else {
-			++pad;
-		}
+		const size_t n = encode_ssse3(in, ilen, out);
+
+		in  += n;
+		out += n / 3 * 4;
+	}
+#endif
+
+	for (; in_end - in >= 3; in += 3) {
+
+		v = (uint32_t)in[0] << 16 | in[1] << 8 | in[2];
 
 		*out++ = b64_table[v>>18 & 0x3f];
 		*out++ = b64_table[v>>12 & 0x3f];
-		*out++ = (pad >= 2) ? '=' : b64_table[v>>6  & 0x3f];
-		*out++ = (pad >= 1) ? '=' : b64_table[v>>0  & 0x3f];
+		*out++ = b64_table[v>>6  & 0x3f];
+		*out++ = b64_table[v>>0  & 0x3f];
+	}
+
+	if (in < in_end) {
+
+		v = (uint32_t)in[0] << 16;
+		if (in + 1 < in_end)
+			v |= in[1] << 8;
+
+		*out++ = b64_table[v>>18 & 0x3f];
+		*out++ = b64_table[v>>12 & 0x3f];
+		*out++ = (in + 1 < in_end) ? b64_table[v>>6 & 0x3f] : '=';
+		*out++ = '=';
 	}
 
 	*olen = out - o;
@@ -65,6 +199,40 @@ int base64_encode(const uint8_t *in, size_t ilen, char *out, size_t *olen)
 }
 
 
+/**
+ * Base-64 encode a buffer into a memory buffer
+ *
+ * @param mb   Memory buffer, written at the current position
+ * @param in   Input buffer
+ * @param ilen Length of input buffer
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int base64_encode_mbuf(struct mbuf *mb, const uint8_t *in, size_t ilen)
+{
+	size_t olen = 4 * ((ilen+2)/3);
+	int err;
+
+	if (!mb || !in)
+		return EINVAL;
+
+	if (mb->pos + olen > mb->size) {
+		err = mbuf_resize(mb, mb->pos + olen);
+		if (err)
+			return err;
+	}
+
+	err = base64_encode(in, ilen, (char *)mbuf_buf(mb), &olen);
+	if (err)
+		return err;
+
+	mb->pos += olen;
+	mb->end  = max(mb->end, mb->pos);
+
+	return 0;
+}
+
+
 int base64_print(struct re_printf *pf, const uint8_t *ptr, size_t len)
 {
 	char buf[256];
@@ -94,40 +262,52 @@ int base64_print(struct re_printf *pf, const uint8_t *ptr, size_t len)
 }
 
 
-/* convert char -> 6-bit value */
-static inline uint32_t b64val(char c)
-{
-	if ('A' <= c && c <= 'Z')
-		return c - 'A' + 0;
-	else if ('a' <= c && c <= 'z')
-		return c - 'a' + 26;
-	else if ('0' <= c && c <= '9')
-		return c - '0' + 52;
-	else if ('+' == c)
-		return 62;
-	else if ('/' == c)
-		return 63;
-	else if ('=' == c)
-		return 1<<24; /* special trick */
-	else
-		return 0;
-}
+enum {
+	INV = 0x100,
+};
+
+
+/* char -> 6-bit value, invalid characters have bit 8 set */
+static const uint16_t b64_dec[256] = {
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV, 62,INV,INV,INV, 63,
+	 52, 53, 54, 55, 56, 57, 58, 59, 60, 61,INV,INV,INV,INV,INV,INV,
+	INV,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,INV,INV,INV,INV,INV,
+	INV, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+	INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,INV,
+};
 
 
 /**
  * Decode a Base-64 encoded string
  *
+ * Padding is only accepted in the last group of four characters, and
+ * a trailing incomplete group is ignored.
+ *
  * @param in   Input buffer
  * @param ilen Length of input buffer
  * @param out  Output buffer
  * @param olen Size of output buffer, actual written on return
  *
- * @return 0 if success, otherwise errorcode
+ * @return 0 if success, EBADMSG if the input contains characters
+ *         outside the alphabet, otherwise errorcode
  */
 int base64_decode(const char *in, size_t ilen, uint8_t *out, size_t *olen)
 {
-	const char *in_end = in + ilen;
+	const uint8_t *p = (const uint8_t *)in;
+	const uint8_t *end = p + (ilen & ~(size_t)3);
 	const uint8_t *o = out;
+	uint32_t v;
 
 	if (!in || !out || !olen)
 		return EINVAL;
@@ -135,19 +315,42 @@ int base64_decode(const char *in, size_t ilen, uint8_t *out, size_t *olen)
 	if (*olen < 3 * (ilen/4))
 		return EOVERFLOW;
 
-	for (;in+3 < in_end; ) {
-		uint32_t v;
+#ifdef BASE64_SSSE3
+	if (ilen >= 24 && have_ssse3()) {
+
+		const size_t n = decode_ssse3(in, ilen, out);
+
+		p   += n;
+		out += n / 4 * 3;
+	}
+#endif
+
+	for (; p < end; p += 4) {
+
+		const uint32_t c0 = b64_dec[p[0]], c1 = b64_dec[p[1]];
+		uint32_t c2 = b64_dec[p[2]], c3 = b64_dec[p[3]];
+		size_t n = 3;
+
+		/* padding is only allowed in the last group */
+		if (p + 4 == end && p[3] == '=') {
+			c3 = 0;
+			n = 2;
+			if (p[2] == '=') {
+				c2 = 0;
+				n = 1;
+			}
+		}
+
+		if ((c0 | c1 | c2 | c3) & INV)
+			return EBADMSG;
 
-		v  = b64val(*in++) << 18;
-		v |= b64val(*in++) << 12;
-		v |= b64val(*in++) << 6;
-		v |= b64val(*in++) << 0;
+		v = c0 << 18 | c1 << 12 | c2 << 6 | c3;
 
 		*out++ = v>>16;
-		if (!(v & (1<<30)))
-			*out++ = (v>>8) & 0xff;
-		if (!(v & (1<<24)))
-			*out++ = (v>>0) & 0xff;
+		if (n > 1)
+			*out++ = v>>8;
+		if (n > 2)
+			*out++ = v;
 	}
 
 	*olen = out - o;
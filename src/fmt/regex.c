@@ -4,10 +4,16 @@
  * Copyright (C) 2010 Creytiv.com
  */
 #include <ctype.h>
+#include <string.h>
 #include <re_types.h>
 #include <re_fmt.h>
 
 
+#define DEBUG_MODULE "regex"
+#define DEBUG_LEVEL 5
+#include <re_dbg.h>
+
+
 /** Defines a character range */
 struct chr {
 	uint8_t min;  /**< Minimum value */
@@ -258,3 +264,327 @@ int re_regex(const char *ptr, size_t len, const char *expr, ...)
 
 	return *ep ? ENOENT : 0;
 }
+
+
+static inline uint8_t lower(uint8_t c)
+{
+	return c < 0x80 ? (uint8_t)tolower(c) : c;
+}
+
+
+static void class_build(uint8_t *map, const struct chr *chrv, uint32_t n,
+			bool neg)
+{
+	unsigned c;
+
+	memset(map, 0, 32);
+
+	for (c=0; c<256; c++) {
+
+		if (expr_match(chrv, n, lower(c), neg))
+			map[c >> 3] |= 1 << (c & 7);
+	}
+}
+
+
+static inline bool class_match(const uint8_t *map, uint8_t c)
+{
+	return (map[c >> 3] >> (c & 7)) & 1;
+}
+
+
+/**
+ * Compile a regular expression into a reusable program. The syntax is
+ * identical to re_regex(), but each character class is converted to a
+ * lookup bitmap once, so that re_regex_exec() does not need to parse
+ * the expression again.
+ *
+ * @param rx   Compiled regular expression (no memory is allocated)
+ * @param expr Regular expressions string, must stay valid
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int re_regex_compile(struct re_regex *rx, const char *expr)
+{
+	struct chr chrv[64];
+	bool fm = false, range = false, ec = false, neg = false;
+	bool qesc = false, eesc = false;
+	const char *ep;
+	uint32_t n = 0;
+	int err = 0;
+
+	if (!rx || !expr)
+		return EINVAL;
+
+	rx->expr = expr;
+	rx->opc  = 0;
+	rx->clsc = 0;
+
+	for (ep = expr; *ep; ep++) {
+
+		struct re_regex_op *op;
+
+		if ('\\' == *ep && !eesc) {
+			eesc = true;
+			continue;
+		}
+
+		if (!fm) {
+
+			/* Start of character class */
+			if ('[' == *ep && !eesc) {
+				n     = 0;
+				fm    = true;
+				ec    = false;
+				neg   = false;
+				range = false;
+				qesc  = false;
+				continue;
+			}
+
+			if (rx->opc >= RE_REGEX_MAXOPS) {
+				err = E2BIG;
+				goto out;
+			}
+
+			op = &rx->opv[rx->opc++];
+			op->iscls = false;
+			op->ch    = lower(*ep);
+
+			eesc = false;
+			continue;
+		}
+		/* End of character class */
+		else if (ec) {
+
+			uint32_t nmin, nmax;
+
+			/* Match 0 or more times */
+			if ('*' == *ep) {
+				nmin = 0;
+				nmax = -1;
+			}
+			/* Match 1 or more times */
+			else if ('+' == *ep) {
+				nmin = 1;
+				nmax = -1;
+			}
+			/* Match exactly n times */
+			else if ('1' <= *ep && *ep <= '9') {
+				nmin = *ep - '0';
+				nmax = *ep - '0';
+			}
+			else
+				break;
+
+			if (rx->opc >= RE_REGEX_MAXOPS ||
+			    rx->clsc >= RE_REGEX_MAXCLS) {
+				err = E2BIG;
+				goto out;
+			}
+
+			fm = false;
+
+			op = &rx->opv[rx->opc++];
+			op->iscls = true;
+			op->qesc  = qesc;
+			op->nmin  = nmin;
+			op->nmax  = nmax;
+			op->cls   = rx->clsc;
+
+			class_build(rx->clsv[rx->clsc++], chrv, n, neg);
+
+			eesc = false;
+			continue;
+		}
+
+		if (eesc) {
+			eesc = false;
+			goto chr;
+		}
+
+		switch (*ep) {
+
+			/* End of character class */
+		case ']':
+			ec = true;
+			continue;
+
+			/* Negate with quote escape */
+		case '~':
+			if (n)
+				break;
+
+			qesc = true;
+			neg  = true;
+			continue;
+
+			/* Negate */
+		case '^':
+			if (n)
+				break;
+
+			neg = true;
+			continue;
+
+			/* Range */
+		case '-':
+			if (!n || range)
+				break;
+
+			range = true;
+			--n;
+			continue;
+		}
+
+	chr:
+		if (n >= ARRAY_SIZE(chrv))
+			break;
+
+		chrv[n].max = tolower(*ep);
+
+		if (range)
+			range = false;
+		else
+			chrv[n].min = tolower(*ep);
+
+		++n;
+	}
+
+	if (fm)
+		err = EINVAL;
+
+ out:
+	rx->err      = err;
+	rx->compiled = true;
+
+	return err;
+}
+
+
+static int regex_match(const struct re_regex *rx, const char *p, size_t l,
+		       va_list ap)
+{
+	uint32_t i;
+
+	for (i=0; i<rx->opc; i++) {
+
+		const struct re_regex_op *op = &rx->opv[i];
+		const uint8_t *map;
+		uint32_t nm;
+		struct pl lpl, *pl;
+		bool quote = false, esc = false;
+
+		if (!op->iscls) {
+
+			if (!l)
+				return ENOENT;
+
+			if (lower(*p) != op->ch)
+				return EAGAIN;
+
+			++p;
+			--l;
+			continue;
+		}
+
+		pl  = va_arg(ap, struct pl *);
+		map = rx->clsv[op->cls];
+
+		lpl.p = p;
+		lpl.l = 0;
+
+		for (nm = 0; l && nm < op->nmax; nm++, p++, l--, lpl.l++) {
+
+			if (op->qesc) {
+
+				if (esc) {
+					esc = false;
+					continue;
+				}
+
+				switch (*p) {
+
+				case '\\':
+					esc = true;
+					continue;
+
+				case '"':
+					quote = !quote;
+					continue;
+				}
+
+				if (quote)
+					continue;
+			}
+
+			if (!class_match(map, *p))
+				break;
+		}
+
+		/* Strip quotes */
+		if (op->qesc && lpl.l > 1 &&
+		    lpl.p[0] == '"' && lpl.p[lpl.l - 1] == '"') {
+
+			lpl.p += 1;
+			lpl.l -= 2;
+			nm    -= 2;
+		}
+
+		if ((nm < op->nmin) || (nm > op->nmax))
+			return EAGAIN;
+
+		if (pl)
+			*pl = lpl;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Parse a string using a compiled regular expression. The matching
+ * semantics are identical to re_regex(). The regular expression is
+ * never modified, so a compiled expression can be shared between
+ * threads. An expression declared with RE_REGEX_INIT() must be compiled
+ * with re_regex_compile() before use.
+ *
+ * @param rx  Compiled regular expression
+ * @param ptr String to parse
+ * @param len Length of string
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int re_regex_exec(const struct re_regex *rx, const char *ptr, size_t len,
+		  ...)
+{
+	va_list ap;
+	int err;
+
+	if (!rx || !ptr)
+		return EINVAL;
+
+	if (!rx->compiled) {
+		DEBUG_WARNING("exec: expression not compiled: %s\n",
+			      rx->expr);
+		return EINVAL;
+	}
+
+	if (rx->err)
+		return rx->err;
+
+	if (!rx->opc)
+		return 0;
+
+	for (; len; ++ptr, --len) {
+
+		va_start(ap, len);
+		err = regex_match(rx, ptr, len, ap);
+		va_end(ap);
+
+		if (err != EAGAIN)
+			return err;
+	}
+
+	return ENOENT;
+}
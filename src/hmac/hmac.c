@@ -10,9 +10,20 @@
 #include <re_hmac.h>
 
 
+/** SHA-1 Block size */
+#ifndef SHA_BLOCKSIZE
+#define SHA_BLOCKSIZE   64
+#endif
+
+
+/*
+ * The padded key is hashed once when the HMAC is created. Each digest
+ * continues from copies of the inner and outer states, which saves two
+ * SHA-1 compressions per digest.
+ */
 struct hmac {
-	uint8_t key[SHA_DIGEST_LENGTH];
-	size_t key_len;
+	SHA_CTX ictx;
+	SHA_CTX octx;
 };
 
 
@@ -24,9 +35,27 @@ static void destructor(void *arg)
 }
 
 
+static void pad_init(SHA_CTX *ctx, const uint8_t *k, size_t lk, uint8_t pad)
+{
+	uint8_t buf[SHA_BLOCKSIZE];
+	size_t i;
+
+	for (i = 0 ; i < lk ; ++i)
+		buf[i] = k[i] ^ pad;
+	for (i = lk ; i < SHA_BLOCKSIZE ; ++i)
+		buf[i] = pad;
+
+	SHA1_Init(ctx);
+	SHA1_Update(ctx, buf, SHA_BLOCKSIZE);
+
+	memset(buf, 0, sizeof(buf));
+}
+
+
 int hmac_create(struct hmac **hmacp, enum hmac_hash hash,
 		const uint8_t *key, size_t key_len)
 {
+	uint8_t kh[SHA_DIGEST_LENGTH];
 	struct hmac *hmac;
 
 	if (!hmacp || !key || !key_len)
@@ -35,15 +64,23 @@ int hmac_create(struct hmac **hmacp, enum hmac_hash hash,
 	if (hash != HMAC_HASH_SHA1)
 		return ENOTSUP;
 
-	if (key_len > SHA_DIGEST_LENGTH)
-		return EINVAL;
-
 	hmac = mem_zalloc(sizeof(*hmac), destructor);
 	if (!hmac)
 		return ENOMEM;
 
-	memcpy(hmac->key, key, key_len);
-	hmac->key_len = key_len;
+	if (key_len > SHA_BLOCKSIZE) {
+		SHA_CTX tctx;
+
+		SHA1_Init(&tctx);
+		SHA1_Update(&tctx, key, key_len);
+		SHA1_Final(kh, &tctx);
+
+		key = kh;
+		key_len = SHA_DIGEST_LENGTH;
+	}
+
+	pad_init(&hmac->ictx, key, key_len, 0x36);
+	pad_init(&hmac->octx, key, key_len, 0x5c);
 
 	*hmacp = hmac;
 
@@ -54,10 +91,21 @@ int hmac_create(struct hmac **hmacp, enum hmac_hash hash,
 int hmac_digest(struct hmac *hmac, uint8_t *md, size_t md_len,
 		const uint8_t *data, size_t data_len)
 {
+	uint8_t isha[SHA_DIGEST_LENGTH], osha[SHA_DIGEST_LENGTH];
+	SHA_CTX ctx;
+
 	if (!hmac || !md || !md_len || !data || !data_len)
 		return EINVAL;
 
-	hmac_sha1(hmac->key, hmac->key_len, data, data_len, md, md_len);
+	ctx = hmac->ictx;
+	SHA1_Update(&ctx, data, data_len);
+	SHA1_Final(isha, &ctx);
+
+	ctx = hmac->octx;
+	SHA1_Update(&ctx, isha, SHA_DIGEST_LENGTH);
+	SHA1_Final(osha, &ctx);
+
+	memcpy(md, osha, min(md_len, (size_t)SHA_DIGEST_LENGTH));
 
 	return 0;
 }
@@ -3,6 +3,9 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include <re_types.h>
 #include <re_mem.h>
 #include <re_mbuf.h>
@@ -131,6 +134,43 @@ static inline int hdr_add(struct http_msg *msg, const struct pl *name,
 }
 
 
+static struct re_regex rx_startline =
+	RE_REGEX_INIT("[\r\n]*[^\r\n]+[\r]*[\n]1");
+static struct re_regex rx_reqline =
+	RE_REGEX_INIT("[a-z]+ [^? ]+[^ ]* HTTP/[0-9.]+");
+static struct re_regex rx_statusline =
+	RE_REGEX_INIT("HTTP/[0-9.]+ [0-9]+[ ]*[^]*");
+
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t rx_once = PTHREAD_ONCE_INIT;
+#else
+static bool rx_done;
+#endif
+
+
+static void regex_compile(void)
+{
+	(void)re_regex_compile(&rx_startline, rx_startline.expr);
+	(void)re_regex_compile(&rx_reqline, rx_reqline.expr);
+	(void)re_regex_compile(&rx_statusline, rx_statusline.expr);
+}
+
+
+/* The patterns are shared by all threads and compiled on first use */
+static void regex_init(void)
+{
+#ifdef HAVE_PTHREAD
+	(void)pthread_once(&rx_once, regex_compile);
+#else
+	if (!rx_done) {
+		regex_compile();
+		rx_done = true;
+	}
+#endif
+}
+
+
 /**
  * Decode a HTTP message
  *
@@ -154,10 +194,12 @@ int http_msg_decode(struct http_msg **msgp, struct mbuf *mb, bool req)
 	if (!msgp || !mb)
 		return EINVAL;
 
+	regex_init();
+
 	p = (const char *)mbuf_buf(mb);
 	l = mbuf_get_left(mb);
 
-	if (re_regex(p, l, "[\r\n]*[^\r\n]+[\r]*[\n]1", &b, &s, NULL, &e))
+	if (re_regex_exec(&rx_startline, p, l, &b, &s, NULL, &e))
 		return (l > STARTLINE_MAX) ? EBADMSG : ENODATA;
 
 	msg = mem_zalloc(sizeof(*msg), destructor);
@@ -173,16 +215,17 @@ int http_msg_decode(struct http_msg **msgp, struct mbuf *mb, bool req)
 	}
 
 	if (req) {
-		if (re_regex(s.p, s.l, "[a-z]+ [^? ]+[^ ]* HTTP/[0-9.]+",
-			     &msg->met, &msg->path, &msg->prm, &msg->ver) ||
+		if (re_regex_exec(&rx_reqline, s.p, s.l,
+				  &msg->met, &msg->path, &msg->prm,
+				  &msg->ver) ||
 		    msg->met.p != s.p) {
 			err = EBADMSG;
 			goto out;
 		}
 	}
 	else {
-		if (re_regex(s.p, s.l, "HTTP/[0-9.]+ [0-9]+[ ]*[^]*",
-			     &msg->ver, &scode, NULL, &msg->reason) ||
+		if (re_regex_exec(&rx_statusline, s.p, s.l,
+				  &msg->ver, &scode, NULL, &msg->reason) ||
 		    msg->ver.p != s.p + 5) {
 			err = EBADMSG;
 			goto out;
@@ -33,6 +33,7 @@ static bool helper_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
 	struct icem *icem = comp->icem;
 	struct stun_msg *msg = NULL;
 	struct stun_unknown_attr ua;
+	struct stun_view view;
 	const size_t start = mb->pos;
 
 #if 0
@@ -40,22 +41,19 @@ static bool helper_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
 		  comp->id, mbuf_get_left(mb), src);
 #endif
 
+	/* Binding requests are handled without decoding a STUN message */
+	if (!stun_view_decode(&view, mb) &&
+	    view.cls == STUN_CLASS_REQUEST) {
+		(void)icem_stund_recv(comp, src, &view, start);
+		return true;  /* handled */
+	}
+
 	if (stun_msg_decode(&msg, mb, &ua))
 		return false;
 
-	if (STUN_METHOD_BINDING == stun_msg_method(msg)) {
-
-		switch (stun_msg_class(msg)) {
-
-		case STUN_CLASS_REQUEST:
-			(void)icem_stund_recv(comp, src, msg, start);
-			break;
-
-		default:
-			(void)stun_ctrans_recv(icem->stun, msg, &ua);
-			break;
-		}
-	}
+	if (STUN_METHOD_BINDING == stun_msg_method(msg) &&
+	    STUN_CLASS_REQUEST != stun_msg_class(msg))
+		(void)stun_ctrans_recv(icem->stun, msg, &ua);
 
 	mem_deref(msg);
 
@@ -10,6 +10,7 @@
 #include <re_list.h>
 #include <re_tmr.h>
 #include <re_sa.h>
+#include <re_hmac.h>
 #include <re_stun.h>
 #include <re_turn.h>
 #include <re_ice.h>
@@ -278,17 +279,17 @@ int icem_conncheck_send(struct ice_candpair *cp, bool use_cand, bool trigged)
 	case ICE_CAND_TYPE_SRFLX:
 	case ICE_CAND_TYPE_PRFLX:
 		cp->ct_conn = mem_deref(cp->ct_conn);
-		err = stun_request(&cp->ct_conn, icem->stun, icem->proto,
-				   cp->comp->sock, &cp->rcand->addr, presz,
-				   STUN_METHOD_BINDING,
-				   (uint8_t *)icem->rpwd, str_len(icem->rpwd),
-				   true, stunc_resp_handler, cp,
-				   4,
-				   STUN_ATTR_USERNAME, username_buf,
-				   STUN_ATTR_PRIORITY, &prio_prflx,
-				   ctrl_attr, &icem->tiebrk,
-				   STUN_ATTR_USE_CAND,
-				   use_cand ? &use_cand : 0);
+		err = stun_request_hmac(&cp->ct_conn, icem->stun,
+					icem->proto, cp->comp->sock,
+					&cp->rcand->addr, presz,
+					STUN_METHOD_BINDING, icem->rhmac,
+					true, stunc_resp_handler, cp,
+					4,
+					STUN_ATTR_USERNAME, username_buf,
+					STUN_ATTR_PRIORITY, &prio_prflx,
+					ctrl_attr, &icem->tiebrk,
+					STUN_ATTR_USE_CAND,
+					use_cand ? &use_cand : 0);
 		break;
 
 	default:
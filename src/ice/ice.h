@@ -72,6 +72,8 @@ struct icem {
 	char *lpwd;                  /**< Local Password                     */
 	char *rufrag;                /**< Remote Username fragment           */
 	char *rpwd;                  /**< Remote Password                    */
+	struct hmac *lhmac;          /**< HMAC of the Local Password         */
+	struct hmac *rhmac;          /**< HMAC of the Remote Password        */
 	ice_connchk_h *chkh;         /**< Connectivity check handler         */
 	void *arg;                   /**< Handler argument                   */
 	char name[32];               /**< Name of the media stream           */
@@ -161,7 +163,7 @@ int  icem_candpairs_debug(struct re_printf *pf, const struct list *list);
 
 /* stun server */
 int icem_stund_recv(struct icem_comp *comp, const struct sa *src,
-		    struct stun_msg *req, size_t presz);
+		    const struct stun_view *req, size_t presz);
 
 
 /* ICE media */
@@ -10,6 +10,7 @@
 #include <re_list.h>
 #include <re_tmr.h>
 #include <re_sa.h>
+#include <re_hmac.h>
 #include <re_stun.h>
 #include <re_turn.h>
 #include <re_ice.h>
@@ -63,6 +64,8 @@ static void icem_destructor(void *data)
 	mem_deref(icem->lpwd);
 	mem_deref(icem->rufrag);
 	mem_deref(icem->rpwd);
+	mem_deref(icem->lhmac);
+	mem_deref(icem->rhmac);
 	mem_deref(icem->stun);
 }
 
@@ -132,6 +135,11 @@ int  icem_alloc(struct icem **icemp,
 	if (err)
 		goto out;
 
+	err = hmac_create(&icem->lhmac, HMAC_HASH_SHA1,
+			  (uint8_t *)lpwd, str_len(lpwd));
+	if (err)
+		goto out;
+
 	ice_determine_role(icem, role);
 
 	if (ICE_MODE_FULL == icem->lmode) {
@@ -11,6 +11,7 @@
 #include <re_list.h>
 #include <re_tmr.h>
 #include <re_sa.h>
+#include <re_hmac.h>
 #include <re_net.h>
 #include <re_stun.h>
 #include <re_ice.h>
@@ -152,6 +153,18 @@ static int ufrag_decode(struct icem *icem, const char *value)
 }
 
 
+static int rhmac_update(struct icem *icem)
+{
+	icem->rhmac = mem_deref(icem->rhmac);
+
+	if (!str_isset(icem->rpwd))
+		return 0;
+
+	return hmac_create(&icem->rhmac, HMAC_HASH_SHA1,
+			   (uint8_t *)icem->rpwd, str_len(icem->rpwd));
+}
+
+
 static int pwd_decode(struct icem *icem, const char *value)
 {
 	char *pwd = NULL;
@@ -166,7 +179,7 @@ static int pwd_decode(struct icem *icem, const char *value)
 
 	mem_deref(pwd);
 
-	return 0;
+	return rhmac_update(icem);
 }
 
 
@@ -180,9 +193,15 @@ static int media_ufrag_decode(struct icem *icem, const char *value)
 
 static int media_pwd_decode(struct icem *icem, const char *value)
 {
+	int err;
+
 	icem->rpwd = mem_deref(icem->rpwd);
 
-	return str_dup(&icem->rpwd, value);
+	err = str_dup(&icem->rpwd, value);
+	if (err)
+		return err;
+
+	return rhmac_update(icem);
 }
 
 
@@ -11,6 +11,7 @@
 #include <re_list.h>
 #include <re_tmr.h>
 #include <re_sa.h>
+#include <re_hmac.h>
 #include <re_stun.h>
 #include <re_ice.h>
 #include <re_sys.h>
@@ -214,24 +215,49 @@ static int handle_stun_lite(struct icem *icem,
 }
 
 
-static int stunsrv_ereply(struct icem_comp *comp, const struct sa *src,
-			  size_t presz, const struct stun_msg *req,
-			  uint16_t scode, const char *reason)
+static int stunsrv_reply(struct icem_comp *comp, const struct sa *src,
+			 size_t presz, const struct stun_view *req,
+			 uint16_t scode, const char *reason)
 {
 	struct icem *icem = comp->icem;
+	struct stun_errcode ec;
+	struct mbuf *mb;
+	int err;
+
+	mb = mbuf_alloc(256);
+	if (!mb)
+		return ENOMEM;
+
+	ec.code   = scode;
+	ec.reason = (char *)reason;
+
+	mb->pos = presz;
+	err = stun_msg_encode_hmac(mb, STUN_METHOD_BINDING,
+				   scode ? STUN_CLASS_ERROR_RESP
+					 : STUN_CLASS_SUCCESS_RESP,
+				   req->tid, scode ? &ec : NULL,
+				   icem->lhmac, true, 0x00, 2,
+				   STUN_ATTR_XOR_MAPPED_ADDR,
+				   scode ? NULL : src,
+				   STUN_ATTR_SOFTWARE, sw);
+	if (err)
+		goto out;
+
+	mb->pos = presz;
+	err = stun_send(icem->proto, comp->sock, src, mb);
 
-	return stun_ereply(icem->proto, comp->sock, src, presz, req,
-			   scode, reason,
-			   (uint8_t *)icem->lpwd, strlen(icem->lpwd), true, 1,
-			   STUN_ATTR_SOFTWARE, sw);
+ out:
+	mem_deref(mb);
+
+	return err;
 }
 
 
 int icem_stund_recv(struct icem_comp *comp, const struct sa *src,
-		    struct stun_msg *req, size_t presz)
+		    const struct stun_view *req, size_t presz)
 {
 	struct icem *icem = comp->icem;
-	struct stun_attr *attr;
+	const char *colon;
 	struct pl lu, ru;
 	enum ice_role rrole = ICE_ROLE_UNKNOWN;
 	uint64_t tiebrk = 0;
@@ -240,11 +266,11 @@ int icem_stund_recv(struct icem_comp *comp, const struct sa *src,
 	int err;
 
 	/* RFC 5389: Fingerprint errors are silently discarded */
-	err = stun_msg_chk_fingerprint(req);
+	err = stun_view_chk_fingerprint(req);
 	if (err)
 		return err;
 
-	err = stun_msg_chk_mi(req, (uint8_t *)icem->lpwd, strlen(icem->lpwd));
+	err = stun_view_chk_hmac(req, icem->lhmac);
 	if (err) {
 		if (err == EBADMSG)
 			goto unauth;
@@ -252,32 +278,35 @@ int icem_stund_recv(struct icem_comp *comp, const struct sa *src,
 			goto badmsg;
 	}
 
-	attr = stun_msg_attr(req, STUN_ATTR_USERNAME);
-	if (!attr)
+	if (!req->username)
 		goto badmsg;
 
-	err = re_regex(attr->v.username, strlen(attr->v.username),
-		       "[^:]+:[^]+", &lu, &ru);
-	if (err) {
-		DEBUG_WARNING("could not parse USERNAME attribute (%s)\n",
-			      attr->v.username);
+	colon = memchr(req->username, ':', req->username_len);
+	if (!colon || colon == req->username ||
+	    colon == req->username + req->username_len - 1) {
+		DEBUG_WARNING("could not parse USERNAME attribute (%b)\n",
+			      req->username, req->username_len);
 		goto unauth;
 	}
+
+	lu.p = req->username;
+	lu.l = colon - req->username;
+	ru.p = colon + 1;
+	ru.l = req->username_len - lu.l - 1;
+
 	if (pl_strcmp(&lu, icem->lufrag))
 		goto unauth;
 	if (str_isset(icem->rufrag) && pl_strcmp(&ru, icem->rufrag))
 		goto unauth;
 
-	attr = stun_msg_attr(req, STUN_ATTR_CONTROLLED);
-	if (attr) {
+	if (req->controlled) {
 		rrole = ICE_ROLE_CONTROLLED;
-		tiebrk = attr->v.uint64;
+		tiebrk = req->tiebrk;
 	}
 
-	attr = stun_msg_attr(req, STUN_ATTR_CONTROLLING);
-	if (attr) {
+	if (req->controlling) {
 		rrole = ICE_ROLE_CONTROLLING;
-		tiebrk = attr->v.uint64;
+		tiebrk = req->tiebrk;
 	}
 
 	if (rrole == icem->lrole) {
@@ -287,14 +316,12 @@ int icem_stund_recv(struct icem_comp *comp, const struct sa *src,
 			goto conflict;
 	}
 
-	attr = stun_msg_attr(req, STUN_ATTR_PRIORITY);
-	if (attr)
-		prio_prflx = attr->v.uint32;
+	if (req->prio)
+		prio_prflx = req->priority;
 	else
 		goto badmsg;
 
-	attr = stun_msg_attr(req, STUN_ATTR_USE_CAND);
-	if (attr)
+	if (req->use_cand)
 		use_cand = true;
 
 	if (icem->lmode == ICE_MODE_FULL) {
@@ -308,17 +335,14 @@ int icem_stund_recv(struct icem_comp *comp, const struct sa *src,
 	if (err)
 		goto badmsg;
 
-	return stun_reply(icem->proto, comp->sock, src, presz, req,
-			  (uint8_t *)icem->lpwd, strlen(icem->lpwd), true, 2,
-			  STUN_ATTR_XOR_MAPPED_ADDR, src,
-			  STUN_ATTR_SOFTWARE, sw);
+	return stunsrv_reply(comp, src, presz, req, 0, NULL);
 
  badmsg:
-	return stunsrv_ereply(comp, src, presz, req, 400, "Bad Request");
+	return stunsrv_reply(comp, src, presz, req, 400, "Bad Request");
 
  unauth:
-	return stunsrv_ereply(comp, src, presz, req, 401, "Unauthorized");
+	return stunsrv_reply(comp, src, presz, req, 401, "Unauthorized");
 
  conflict:
-	return stunsrv_ereply(comp, src, presz, req, 487, "Role Conflict");
+	return stunsrv_reply(comp, src, presz, req, 487, "Role Conflict");
 }
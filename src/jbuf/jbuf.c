@@ -9,6 +9,7 @@
 #include <re_list.h>
 #include <re_mbuf.h>
 #include <re_mem.h>
+#include <re_tmr.h>
 #include <re_rtp.h>
 #include <re_jbuf.h>
 
@@ -23,6 +24,13 @@
 #endif
 
 
+enum {
+	JBUF_JITTER_FACTOR = 3,    /**< Buffer this many times the jitter   */
+	JBUF_SHRINK_WAIT   = 100,  /**< Puts before the target shrinks      */
+	JBUF_DRAIN_WAIT    = 50,   /**< Gets per fill level window          */
+};
+
+
 #if JBUF_STAT
 #define STAT_ADD(var, value)  (jb->stat.var) += (value) /**< Stats add */
 #define STAT_INC(var)         ++(jb->stat.var)          /**< Stats inc */
@@ -34,9 +42,9 @@
 
 /** Defines a packet frame */
 struct frame {
-	struct le le;           /**< Linked list element       */
 	struct rtp_header hdr;  /**< RTP Header                */
 	void *mem;              /**< Reference counted pointer */
+	bool used;              /**< Slot holds a frame        */
 };
 
 
@@ -44,17 +52,32 @@ struct frame {
  * Defines a jitter buffer
  *
  * The jitter buffer is for incoming RTP packets, which are sorted by
- * sequence number.
+ * sequence number. Frames are stored in a ring indexed by the sequence
+ * number modulo the ring size, so that insertion, removal and duplicate
+ * detection are O(1) regardless of reordering.
  */
 struct jbuf {
-	struct list pooll;   /**< List of free frames in pool               */
-	struct list framel;  /**< List of buffered frames                   */
+	struct frame *framev; /**< Ring of frames, indexed by seq            */
+	uint32_t sz;         /**< Ring size, power of two                   */
 	uint32_t n;          /**< [# frames] Current # of frames in buffer  */
 	uint32_t min;        /**< [# frames] Minimum # of frames to buffer  */
 	uint32_t max;        /**< [# frames] Maximum # of frames to buffer  */
+	uint16_t seq_head;   /**< Sequence number of oldest frame           */
+	uint16_t seq_tail;   /**< Sequence number of newest frame           */
 	uint16_t seq_put;    /**< Sequence number for last jbuf_put()       */
 	bool running;        /**< Jitter buffer is running                  */
 
+	enum jbuf_type jbtype; /**< Jitter buffer type                      */
+	uint32_t srate;      /**< RTP clock rate [Hz]                       */
+	int transit;         /**< Relative transit time of last frame       */
+	uint32_t jitter;     /**< Jitter estimate [ts units, scaled by 16]  */
+	uint32_t ts_put;     /**< RTP timestamp for last jbuf_put()         */
+	uint32_t ptime;      /**< Frame duration [ts units]                 */
+	uint32_t target;     /**< [# frames] Target # of frames (adaptive)  */
+	uint32_t shrink;     /**< Number of puts wanting a lower target     */
+	uint32_t nmin;       /**< [# frames] Minimum fill level in window   */
+	uint32_t ngets;      /**< Number of gets in fill level window       */
+
 #if JBUF_STAT
 	uint16_t seq_get;      /**< Timestamp of last played frame */
 	struct jbuf_stat stat; /**< Jitter buffer Statistics       */
@@ -69,46 +92,88 @@ static inline bool seq_less(uint16_t x, uint16_t y)
 }
 
 
+static inline struct frame *frame_slot(const struct jbuf *jb, uint16_t seq)
+{
+	return &jb->framev[seq & (jb->sz - 1)];
+}
+
+
 /**
- * Get a frame from the pool
+ * Remove the oldest frame, and advance the head to the next frame
  */
-static void frame_alloc(struct jbuf *jb, struct frame **f)
+static struct frame *frame_pop(struct jbuf *jb)
 {
-	struct le *le;
+	struct frame *f = frame_slot(jb, jb->seq_head);
+
+	f->used = false;
 
-	le = jb->pooll.head;
-	if (le) {
-		list_unlink(le);
-		++jb->n;
+	if (--jb->n) {
+		do {
+			++jb->seq_head;
+		} while (!frame_slot(jb, jb->seq_head)->used);
 	}
-	else {
-		struct frame *f0;
 
-		/* Steal an old frame */
-		le = jb->framel.head;
-		f0 = le->data;
+	return f;
+}
 
-		STAT_INC(n_overflow);
-		DEBUG_INFO("drop 1 old frame seq=%u (total dropped %u)\n",
-			   f0->hdr.seq, jb->stat.n_overflow);
 
-		f0->mem = mem_deref(f0->mem);
-		list_unlink(le);
-	}
+/**
+ * Drop the oldest frame to make room for a new one
+ */
+static void frame_drop(struct jbuf *jb)
+{
+	struct frame *f0 = frame_pop(jb);
+
+	STAT_INC(n_overflow);
+	DEBUG_INFO("drop 1 old frame seq=%u (total dropped %u)\n",
+		   f0->hdr.seq, jb->stat.n_overflow);
 
-	*f = le->data;
+	f0->mem = mem_deref(f0->mem);
 }
 
 
 /**
- * Release a frame, put it back in the pool
+ * Update the jitter estimate and the target depth from a new frame
  */
-static void frame_deref(struct jbuf *jb, struct frame *f)
+static void adapt(struct jbuf *jb, const struct rtp_header *hdr, bool inseq)
 {
-	f->mem = mem_deref(f->mem);
-	list_unlink(&f->le);
-	list_append(&jb->pooll, &f->le, f);
-	--jb->n;
+	uint32_t arrival, want;
+
+	arrival = (uint32_t)(tmr_jiffies() * jb->srate / 1000);
+	rtp_jitter_calc(&jb->transit, &jb->jitter, hdr->ts, arrival);
+
+	/* Frame duration from two consecutive frames */
+	if (inseq && hdr->ts != jb->ts_put &&
+	    (uint32_t)(hdr->ts - jb->ts_put) < jb->srate)
+		jb->ptime = hdr->ts - jb->ts_put;
+
+	jb->ts_put = hdr->ts;
+
+	if (!jb->ptime)
+		return;
+
+	want = (JBUF_JITTER_FACTOR * (jb->jitter >> 4) + jb->ptime - 1) /
+		jb->ptime;
+	want = min(want, jb->max - 1);
+	want = max(want, jb->min);
+
+	/* Grow at once, shrink slowly */
+	if (want > jb->target) {
+		DEBUG_INFO("target: %u -> %u frames\n", jb->target, want);
+		jb->target = want;
+		jb->shrink = 0;
+	}
+	else if (want < jb->target) {
+		if (++jb->shrink >= JBUF_SHRINK_WAIT) {
+			DEBUG_INFO("target: %u -> %u frames\n",
+				   jb->target, jb->target - 1);
+			--jb->target;
+			jb->shrink = 0;
+		}
+	}
+	else {
+		jb->shrink = 0;
+	}
 }
 
 
@@ -118,8 +183,7 @@ static void jbuf_destructor(void *data)
 
 	jbuf_flush(jb);
 
-	/* Free all frames in the pool list */
-	list_flush(&jb->pooll);
+	mem_deref(jb->framev);
 }
 
 
@@ -135,10 +199,10 @@ static void jbuf_destructor(void *data)
 int jbuf_alloc(struct jbuf **jbp, uint32_t min, uint32_t max)
 {
 	struct jbuf *jb;
-	uint32_t i;
+	uint32_t sz;
 	int err = 0;
 
-	if (!jbp || ( min > max))
+	if (!jbp || ( min > max) || !max || max > 16384)
 		return EINVAL;
 
 	DEBUG_INFO("alloc: delay=%u-%u frames\n", min, max);
@@ -153,24 +217,24 @@ int jbuf_alloc(struct jbuf **jbp, uint32_t min, uint32_t max)
 	if (!jb)
 		return ENOMEM;
 
-	list_init(&jb->pooll);
-	list_init(&jb->framel);
+	jb->min    = min;
+	jb->max    = max;
+	jb->target = min;
 
-	jb->min  = min;
-	jb->max  = max;
+	/* Ring spans twice the maximum depth, to leave room for gaps */
+	for (sz = 2; sz < 2 * max; sz <<= 1)
+		;
 
 	/* Allocate all frames now */
-	for (i=0; i<jb->max; i++) {
-		struct frame *f = mem_zalloc(sizeof(*f), NULL);
-		if (!f) {
-			err = ENOMEM;
-			break;
-		}
-
-		list_append(&jb->pooll, &f->le, f);
-		DEBUG_INFO("alloc: adding to pool list %u\n", i);
+	jb->framev = mem_zalloc(sz * sizeof(*jb->framev), NULL);
+	if (!jb->framev) {
+		err = ENOMEM;
+		goto out;
 	}
 
+	jb->sz = sz;
+
+ out:
 	if (err)
 		mem_deref(jb);
 	else
@@ -192,14 +256,14 @@ int jbuf_alloc(struct jbuf **jbp, uint32_t min, uint32_t max)
 int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
 {
 	struct frame *f;
-	struct le *le, *tail;
 	uint16_t seq;
-	int err = 0;
+	bool inseq;
 
 	if (!jb || !hdr)
 		return EINVAL;
 
 	seq = hdr->seq;
+	inseq = jb->running && seq == (uint16_t)(jb->seq_put + 1);
 
 	STAT_INC(n_put);
 
@@ -214,60 +278,67 @@ int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
 		}
 	}
 
-	frame_alloc(jb, &f);
+	if (jb->n && seq_less(jb->seq_tail, seq)) {
 
-	tail = jb->framel.tail;
-
-	/* If buffer is empty -> append to tail
-	   Frame is later than tail -> append to tail
-	*/
-	if (!tail || seq_less(((struct frame *)tail->data)->hdr.seq, seq)) {
-		list_append(&jb->framel, &f->le, f);
-		goto out;
+		/* Frame is later than tail -- make room in the ring */
+		while (jb->n && (uint16_t)(seq - jb->seq_head) >= jb->sz)
+			frame_drop(jb);
 	}
+	else if (jb->n) {
 
-	/* Out-of-sequence, find right position */
-	for (le = tail; le; le = le->prev) {
-		const uint16_t seq_le = ((struct frame *)le->data)->hdr.seq;
+		f = frame_slot(jb, seq);
 
-		if (seq_less(seq_le, seq)) { /* most likely */
-			DEBUG_INFO("put: out-of-sequence"
-				   " - inserting after seq=%u (seq=%u)\n",
-				   seq_le, seq);
-			list_insert_after(&jb->framel, le, &f->le, f);
-			break;
-		}
-		else if (seq == seq_le) { /* less likely */
-			/* Detect duplicates */
+		/* Detect duplicates */
+		if (f->used && f->hdr.seq == seq) {
 			DEBUG_INFO("duplicate: seq=%u\n", seq);
 			STAT_INC(n_dups);
-			list_insert_after(&jb->framel, le, &f->le, f);
-			frame_deref(jb, f);
 			return EALREADY;
 		}
 
-		/* sequence number less than current seq, continue */
+		/* Earlier than head, but outside the ring */
+		if (seq_less(seq, jb->seq_head) &&
+		    (uint16_t)(jb->seq_tail - seq) >= jb->sz) {
+			STAT_INC(n_late);
+			DEBUG_INFO("packet too old: seq=%u (head=%u)\n",
+				   seq, jb->seq_head);
+			return ETIMEDOUT;
+		}
+
+		DEBUG_INFO("put: out-of-sequence (seq=%u)\n", seq);
+		STAT_INC(n_oos);
 	}
 
-	/* no earlier timestamps found, put in head */
-	if (!le) {
-		DEBUG_INFO("put: out-of-sequence"
-			   " - put in head (seq=%u)\n", seq);
-		list_prepend(&jb->framel, &f->le, f);
+	/* Buffer full -- steal an old frame */
+	if (jb->n >= jb->max)
+		frame_drop(jb);
+
+	if (!jb->n) {
+		jb->seq_head = seq;
+		jb->seq_tail = seq;
+	}
+	else if (seq_less(seq, jb->seq_head)) {
+		jb->seq_head = seq;
+	}
+	else if (seq_less(jb->seq_tail, seq)) {
+		jb->seq_tail = seq;
 	}
 
-	STAT_INC(n_oos);
+	++jb->n;
+
+	if (jb->jbtype == JBUF_ADAPTIVE && jb->srate)
+		adapt(jb, hdr, inseq);
 
- out:
 	/* Update last timestamp */
 	jb->running = true;
 	jb->seq_put = seq;
 
 	/* Success */
-	f->hdr = *hdr;
-	f->mem = mem_ref(mem);
+	f = frame_slot(jb, seq);
+	f->hdr  = *hdr;
+	f->mem  = mem_ref(mem);
+	f->used = true;
 
-	return err;
+	return 0;
 }
 
 
@@ -283,24 +354,43 @@ int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
 int jbuf_get(struct jbuf *jb, struct rtp_header *hdr, void **mem)
 {
 	struct frame *f;
+	uint32_t lim;
 
 	if (!jb || !hdr || !mem)
 		return EINVAL;
 
 	STAT_INC(n_get);
 
-	if (jb->n <= jb->min || !jb->framel.head) {
+	lim = (jb->jbtype == JBUF_ADAPTIVE) ? jb->target : jb->min;
+
+	if (jb->n <= lim || !jb->n) {
 		DEBUG_INFO("not enough buffer frames - wait.. (n=%u min=%u)\n",
-			   jb->n, jb->min);
+			   jb->n, lim);
 		STAT_INC(n_underflow);
 		return ENOENT;
 	}
 
+	/* Adaptive: drain one frame if the fill level stayed above the
+	   target for a whole window, e.g. after the target was lowered */
+	if (jb->jbtype == JBUF_ADAPTIVE) {
+
+		jb->nmin = min(jb->nmin, jb->n);
+
+		if (++jb->ngets >= JBUF_DRAIN_WAIT) {
+
+			if (jb->nmin > lim + 1)
+				frame_drop(jb);
+
+			jb->nmin  = (uint32_t)-1;
+			jb->ngets = 0;
+		}
+	}
+
 	/* When we get one frame F[i], check that the next frame F[i+1]
 	   is present and have a seq no. of seq[i] + 1 !
 	   if not, we should consider that packet lost */
 
-	f = jb->framel.head->data;
+	f = frame_pop(jb);
 
 #if JBUF_STAT
 	/* Check timestamp of previously played frame */
@@ -321,9 +411,8 @@ int jbuf_get(struct jbuf *jb, struct rtp_header *hdr, void **mem)
 #endif
 
 	*hdr = f->hdr;
-	*mem = mem_ref(f->mem);
-
-	frame_deref(jb, f);
+	*mem = f->mem;   /* reference is handed over to the caller */
+	f->mem = NULL;
 
 	return 0;
 }
@@ -336,7 +425,6 @@ int jbuf_get(struct jbuf *jb, struct rtp_header *hdr, void **mem)
  */
 void jbuf_flush(struct jbuf *jb)
 {
-	struct le *le;
 #if JBUF_STAT
 	uint32_t n_flush;
 #endif
@@ -344,20 +432,21 @@ void jbuf_flush(struct jbuf *jb)
 	if (!jb)
 		return;
 
-	if (jb->framel.head) {
+	if (jb->n) {
 		DEBUG_INFO("flush: %u frames\n", jb->n);
 	}
 
-	/* put all buffered frames back in free list */
-	for (le = jb->framel.head; le; le = jb->framel.head) {
-		DEBUG_INFO(" flush frame: seq=%u\n",
-			   ((struct frame *)(le->data))->hdr.seq);
+	/* release all buffered frames */
+	while (jb->n) {
+		struct frame *f = frame_pop(jb);
+
+		DEBUG_INFO(" flush frame: seq=%u\n", f->hdr.seq);
 
-		frame_deref(jb, le->data);
+		f->mem = mem_deref(f->mem);
 	}
 
-	jb->n       = 0;
 	jb->running = false;
+	jb->transit = 0;
 
 #if JBUF_STAT
 	n_flush = STAT_INC(n_flush);
@@ -369,9 +458,77 @@ void jbuf_flush(struct jbuf *jb)
 }
 
 
+/**
+ * Set the jitter buffer type
+ *
+ * In adaptive mode the inter-arrival jitter is estimated from the RTP
+ * timestamps, and frames are released when more than a target number
+ * of frames are buffered. The target is kept between the minimum and
+ * maximum delay given to jbuf_alloc(). The clock rate must be set with
+ * jbuf_set_srate().
+ *
+ * @param jb     Jitter buffer
+ * @param jbtype Jitter buffer type
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_set_type(struct jbuf *jb, enum jbuf_type jbtype)
+{
+	if (!jb)
+		return EINVAL;
+
+	jb->jbtype = jbtype;
+	jb->target = jb->min;
+	jb->shrink = 0;
+	jb->nmin   = (uint32_t)-1;
+	jb->ngets  = 0;
+
+	return 0;
+}
+
+
+/**
+ * Set the RTP clock rate, used by the adaptive mode
+ *
+ * @param jb    Jitter buffer
+ * @param srate RTP clock rate in [Hz]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_set_srate(struct jbuf *jb, uint32_t srate)
+{
+	if (!jb || !srate)
+		return EINVAL;
+
+	jb->srate   = srate;
+	jb->transit = 0;
+	jb->jitter  = 0;
+	jb->ptime   = 0;
+
+	return 0;
+}
+
+
+static void delay_stats(const struct jbuf *jb, struct jbuf_stat *jstat)
+{
+	if (!jb->srate)
+		return;
+
+	jstat->c_delay = (uint32_t)((uint64_t)jb->n * jb->ptime * 1000 /
+				    jb->srate);
+	jstat->t_delay = (uint32_t)((uint64_t)jb->target * jb->ptime * 1000 /
+				    jb->srate);
+	jstat->jitter  = (uint32_t)((uint64_t)(jb->jitter >> 4) * 1000 /
+				    jb->srate);
+}
+
+
 /**
  * Get jitter buffer statistics
  *
+ * The delay and jitter values are always filled in, the counters only
+ * if statistics are enabled (otherwise ENOSYS is returned).
+ *
  * @param jb    Jitter buffer
  * @param jstat Pointer to statistics storage
  *
@@ -384,9 +541,13 @@ int jbuf_stats(const struct jbuf *jb, struct jbuf_stat *jstat)
 
 #if JBUF_STAT
 	*jstat = jb->stat;
+	delay_stats(jb, jstat);
 
 	return 0;
 #else
+	memset(jstat, 0, sizeof(*jstat));
+	delay_stats(jb, jstat);
+
 	return ENOSYS;
 #endif
 }
@@ -414,6 +575,12 @@ int jbuf_debug(struct re_printf *pf, const struct jbuf *jb)
 			  jb->min, jb->n, jb->max);
 	err |= re_hprintf(pf, " seq_put=%u\n", jb->seq_put);
 
+	if (jb->jbtype == JBUF_ADAPTIVE) {
+		err |= re_hprintf(pf, " adaptive: target=%u [frames]"
+				  " jitter=%u ptime=%u [ts]\n",
+				  jb->target, jb->jitter >> 4, jb->ptime);
+	}
+
 #if JBUF_STAT
 	err |= re_hprintf(pf, " Stat: put=%u", jb->stat.n_put);
 	err |= re_hprintf(pf, " get=%u", jb->stat.n_get);
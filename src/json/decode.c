@@ -4,6 +4,8 @@
  * Copyright (C) 2010 - 2015 Creytiv.com
  */
 
+#include <stdlib.h>
+#include <string.h>
 #include <re_types.h>
 #include <re_fmt.h>
 #include <re_mem.h>
@@ -11,6 +13,7 @@
 #include <re_hash.h>
 #include <re_odict.h>
 #include <re_json.h>
+#include "json.h"
 
 
 static inline long double mypower10(uint64_t e)
@@ -44,74 +47,301 @@ static bool is_string(struct pl *c, const struct pl *pl)
 }
 
 
-static bool is_number(long double *d, bool *isfloat, const struct pl *pl)
+/* Exactly representable powers of ten */
+static const double pow10tab[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+	1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+enum {
+	MAX_DIGITS  = 19,       /* significant digits that fit in uint64_t */
+	MAX_EXP     = 100000,   /* saturation limit for the exponent       */
+	FAST_EXP    = 22,       /* largest exact power of ten in a double  */
+	MANT_BITS   = 52,       /* explicit mantissa bits of a double      */
+	EXP_BIAS    = 1023,
+	EXP_INF     = 0x7ff,
+};
+
+#define MAX_EXACT_MANT (1ULL << 53)
+
+
+static inline void mul128(uint64_t *hi, uint64_t *lo, uint64_t a, uint64_t b)
+{
+	const uint64_t a0 = (uint32_t)a, a1 = a >> 32;
+	const uint64_t b0 = (uint32_t)b, b1 = b >> 32;
+	const uint64_t p00 = a0 * b0, p01 = a0 * b1;
+	const uint64_t p10 = a1 * b0, p11 = a1 * b1;
+	const uint64_t mid = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+
+	*hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+	*lo = (mid << 32) | (uint32_t)p00;
+}
+
+
+static inline int clz64(uint64_t x)
+{
+#if defined(__GNUC__)
+	return __builtin_clzll(x);
+#else
+	int n = 0;
+
+	while (!(x & (1ULL << 63))) {
+		x <<= 1;
+		++n;
+	}
+
+	return n;
+#endif
+}
+
+
+static inline double bits2double(uint64_t u)
+{
+	union {
+		uint64_t u;
+		double d;
+	} v;
+
+	v.u = u;
+
+	return v.d;
+}
+
+
+/*
+ * Eisel-Lemire algorithm: convert w * 10^q to the nearest double using
+ * a truncated 128-bit product with 5^q. Correctly rounded for all w
+ * that fit in 64 bits.
+ */
+static double eisel_lemire(uint64_t w, int64_t q)
+{
+	uint64_t hi, lo, mant;
+	int64_t pow2;
+	int lz, upper, shift;
+	size_t idx;
+
+	if (!w || q < JSON_POW5_MIN)
+		return 0.0;
+
+	if (q > JSON_POW5_MAX)
+		return bits2double((uint64_t)EXP_INF << MANT_BITS);
+
+	lz = clz64(w);
+	w <<= lz;
+
+	idx = 2 * (size_t)(q - JSON_POW5_MIN);
+	mul128(&hi, &lo, w, json_pow5tab[idx]);
+
+	/* refine with the low word if the precision bits are all ones */
+	if ((hi & 0x1ff) == 0x1ff) {
+
+		uint64_t hi2, lo2;
+
+		mul128(&hi2, &lo2, w, json_pow5tab[idx + 1]);
+		lo += hi2;
+		if (hi2 > lo)
+			++hi;
+	}
+
+	upper = (int)(hi >> 63);
+	shift = upper + 64 - MANT_BITS - 3;
+	mant  = hi >> shift;
+	pow2  = (((152170 + 65536) * q) >> 16) + 63 + upper - lz + EXP_BIAS;
+
+	/* subnormal */
+	if (pow2 <= 0) {
+
+		if (-pow2 + 1 >= 64)
+			return 0.0;
+
+		mant >>= -pow2 + 1;
+		mant += mant & 1;
+		mant >>= 1;
+		pow2 = (mant < (1ULL << MANT_BITS)) ? 0 : 1;
+
+		return bits2double(mant | (uint64_t)pow2 << MANT_BITS);
+	}
+
+	/* exactly halfway between two doubles: round to even */
+	if (lo <= 1 && q >= -4 && q <= 23 && (mant & 3) == 1) {
+
+		if ((mant << shift) == hi)
+			mant &= ~1ULL;
+	}
+
+	mant += mant & 1;
+	mant >>= 1;
+
+	if (mant >= (2ULL << MANT_BITS)) {
+		mant = 1ULL << MANT_BITS;
+		++pow2;
+	}
+
+	mant &= ~(1ULL << MANT_BITS);
+
+	if (pow2 >= EXP_INF)
+		return bits2double((uint64_t)EXP_INF << MANT_BITS);
+
+	return bits2double(mant | (uint64_t)pow2 << MANT_BITS);
+}
+
+
+/*
+ * Rare case of more than 19 significant digits that are not resolved by
+ * the fast paths -- let the C library do correct rounding.
+ */
+static double slow_number(const struct pl *pl, uint64_t mant, int64_t e10)
+{
+	char buf[512];
+	long double v;
+
+	if (pl->l < sizeof(buf)) {
+
+		memcpy(buf, pl->p, pl->l);
+		buf[pl->l] = '\0';
+
+		return strtod(buf, NULL);
+	}
+
+	v = mant;
+
+	if (e10 < 0)
+		v /= mypower10(-e10);
+	else
+		v *= mypower10(e10);
+
+	return (double)(pl->p[0] == '-' ? -v : v);
+}
+
+
+/*
+ * Parse a JSON number in a single forward pass. Integers are decoded
+ * directly into int64_t. Floats use the exact fast path (Clinger) when
+ * the mantissa and the power of ten are both exactly representable in a
+ * double, and the Eisel-Lemire algorithm otherwise.
+ */
+static bool decode_number(struct json_value *val, const struct pl *pl)
 {
-	bool neg = false, pos = false, frac = false, exp = false;
-	long double v = 0, mul = 1;
-	const char *p;
-	int64_t e = 0;
+	const char *p = pl->p, *end = pl->p + pl->l;
+	bool neg = false, frac = false, exp = false, trunc = false;
+	unsigned ndig = 0, ndigits = 0;
+	uint64_t mant = 0;
+	int64_t e10 = 0;
 
-	if (!pl->l)
+	if (p == end)
 		return false;
 
-	p = &pl->p[pl->l];
+	if (*p == '-' || *p == '+')
+		neg = (*p++ == '-');
 
-	while (p > pl->p) {
+	for (; p < end; ++p) {
 
-		const char ch = *--p;
+		const char ch = *p;
 
-		if (ch == 'e' || ch == 'E') {
+		if ('0' <= ch && ch <= '9') {
 
-			if (exp || frac)
-				return false;
+			++ndigits;
 
-			exp = true;
-			e   = neg ? -v : v;
-			v   = 0;
-			mul = 1;
-			neg = false;
-			pos = false;
+			if (ndig < MAX_DIGITS) {
+				mant = mant * 10 + (ch - '0');
+				if (mant)
+					++ndig;
+				if (frac)
+					--e10;
+			}
+			else {
+				if (ch != '0')
+					trunc = true;
+				if (!frac)
+					++e10;
+			}
 		}
-		else if (pos || neg) {
-			return false;
+		else if (ch == '.' && !frac) {
+			frac = true;
 		}
-		else if (ch == '.') {
+		else
+			break;
+	}
+
+	if (!ndigits)
+		return false;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+
+		bool eneg = false;
+		int64_t e = 0;
 
-			if (frac)
+		exp = true;
+
+		if (++p < end && (*p == '-' || *p == '+'))
+			eneg = (*p++ == '-');
+
+		if (p == end)
+			return false;
+
+		for (; p < end; ++p) {
+
+			if (*p < '0' || *p > '9')
 				return false;
 
-			frac = true;
-			v /= mul;
-			mul = 1;
-		}
-		else if ('0' <= ch && ch <= '9') {
-			v += mul * (ch - '0');
-			mul *= 10;
+			if (e < MAX_EXP)
+				e = e * 10 + (*p - '0');
 		}
-		else if (ch == '-') {
-			neg = true;
-		}
-		else if (ch == '+') {
-			pos = true;
+
+		e10 += eneg ? -e : e;
+	}
+
+	if (p != end)
+		return false;
+
+	if (!frac && !exp && !trunc && e10 == 0) {
+
+		if (!neg && mant <= INT64_MAX) {
+			val->type      = JSON_INT;
+			val->v.integer = (int64_t)mant;
+			return true;
 		}
-		else {
-			return false;
+		else if (neg && mant <= (uint64_t)INT64_MAX + 1) {
+			val->type      = JSON_INT;
+			val->v.integer = (int64_t)(0 - mant);
+			return true;
 		}
 	}
 
-	*isfloat = (frac || exp);
+	val->type = JSON_DOUBLE;
 
-	if (exp) {
-		if (e < 0)
-			v /= mypower10(-e);
+	if (!trunc && mant <= MAX_EXACT_MANT &&
+	    -FAST_EXP <= e10 && e10 <= FAST_EXP) {
+
+		double d = (double)mant;
+
+		if (e10 < 0)
+			d /= pow10tab[-e10];
 		else
-			v *= mypower10(e);
+			d *= pow10tab[e10];
+
+		val->v.dbl = d;
 	}
+	else if (!trunc) {
+		val->v.dbl = eisel_lemire(mant, e10);
+	}
+	else {
+		/* digits were dropped: exact if both bounds agree */
+		const double d = eisel_lemire(mant, e10);
 
-	if (neg)
-		v = -v;
+		if (mant < UINT64_MAX && d == eisel_lemire(mant + 1, e10)) {
+			val->v.dbl = d;
+		}
+		else {
+			val->v.dbl = slow_number(pl, mant, e10);
+			neg = false;
+		}
+	}
 
-	*d = v;
+	if (neg)
+		val->v.dbl = -val->v.dbl;
 
 	return true;
 }
@@ -133,9 +363,7 @@ static int decode_name(char **str, const struct pl *pl)
 
 static int decode_value(struct json_value *val, const struct pl *pl)
 {
-	long double dbl;
 	struct pl pls;
-	bool isfloat;
 	int err = 0;
 
 	if (!pl->p)
@@ -146,16 +374,8 @@ static int decode_value(struct json_value *val, const struct pl *pl)
 		err = re_sdprintf(&val->v.str, "%H", utf8_decode, &pls);
 		val->type = JSON_STRING;
 	}
-	else if (is_number(&dbl, &isfloat, pl)) {
-
-		if (isfloat) {
-			val->type  = JSON_DOUBLE;
-			val->v.dbl = dbl;
-		}
-		else {
-			val->type      = JSON_INT;
-			val->v.integer = dbl;
-		}
+	else if (decode_number(val, pl)) {
+		/* type and value set by decode_number() */
 	}
 	else if (!pl_strcasecmp(pl, "false")) {
 
@@ -3,8 +3,10 @@
  *
  * Copyright (C) 2010 - 2015 Creytiv.com
  */
+#include <string.h>
 #include <re_types.h>
 #include <re_fmt.h>
+#include <re_mbuf.h>
 #include <re_list.h>
 #include <re_odict.h>
 #include <re_json.h>
@@ -97,3 +99,287 @@ int json_encode_odict(struct re_printf *pf, const struct odict *o)
 
 	return err;
 }
+
+
+/*
+ * Direct-to-buffer encoder
+ *
+ * The size of the output is computed in a first pass, so that the
+ * buffer can be resized once and the second pass writes without any
+ * bounds checks or printf formatting.
+ */
+
+enum {
+	INT_MAXLEN = 20,   /* "-9223372036854775808" */
+	DBL_MAXLEN = 66,   /* "%f" output incl. sign and NUL */
+};
+
+/* Escape character for each byte: 0 = none, 'u' = \u00XX */
+static const uint8_t esc_tab[256] = {
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '/',
+	['\\'] = '\\',
+};
+
+static const char hex_chars[] = "0123456789ABCDEF";
+
+
+static size_t str_size(const char *s)
+{
+	const uint8_t *p = (const uint8_t *)s;
+	size_t n = 2;
+
+	if (!p)
+		return n;
+
+	for (; *p; ++p) {
+
+		switch (esc_tab[*p]) {
+
+		case 0:   n += 1; break;
+		case 'u': n += 6; break;
+		default:  n += 2; break;
+		}
+	}
+
+	return n;
+}
+
+
+static char *str_write(char *d, const char *s)
+{
+	const uint8_t *p = (const uint8_t *)s;
+
+	*d++ = '"';
+
+	if (!p) {
+		*d++ = '"';
+		return d;
+	}
+
+	for (;;) {
+
+		const uint8_t *run = p;
+		uint8_t ec;
+
+		while (*p && !esc_tab[*p])
+			++p;
+
+		memcpy(d, run, p - run);
+		d += p - run;
+
+		if (!*p)
+			break;
+
+		ec = esc_tab[*p];
+		*d++ = '\\';
+
+		if (ec == 'u') {
+			*d++ = 'u';
+			*d++ = '0';
+			*d++ = '0';
+			*d++ = hex_chars[(*p >> 4) & 0xf];
+			*d++ = hex_chars[*p & 0xf];
+		}
+		else {
+			*d++ = (char)ec;
+		}
+
+		++p;
+	}
+
+	*d++ = '"';
+
+	return d;
+}
+
+
+static char *int_write(char *d, int64_t v)
+{
+	char buf[INT_MAXLEN];
+	char *p = buf + sizeof(buf);
+	uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+
+	do {
+		*--p = '0' + (char)(u % 10);
+		u /= 10;
+	} while (u);
+
+	if (v < 0)
+		*d++ = '-';
+
+	memcpy(d, p, buf + sizeof(buf) - p);
+
+	return d + (buf + sizeof(buf) - p);
+}
+
+
+static size_t odict_size(const struct odict *o, bool array);
+
+
+static size_t entry_size(const struct odict_entry *e)
+{
+	switch (e->type) {
+
+	case ODICT_OBJECT: return odict_size(e->u.odict, false);
+	case ODICT_ARRAY:  return odict_size(e->u.odict, true);
+	case ODICT_INT:    return INT_MAXLEN;
+	case ODICT_DOUBLE: return DBL_MAXLEN;
+	case ODICT_STRING: return str_size(e->u.str);
+	case ODICT_BOOL:   return 5;
+	case ODICT_NULL:   return 4;
+	default:           return 0;
+	}
+}
+
+
+static size_t odict_size(const struct odict *o, bool array)
+{
+	struct le *le;
+	size_t n;
+
+	if (!o)
+		return 0;
+
+	n = 2;
+
+	for (le=o->lst.head; le; le=le->next) {
+
+		const struct odict_entry *e = le->data;
+
+		if (!array)
+			n += str_size(e->key) + 1;
+
+		n += entry_size(e) + 1;
+	}
+
+	return n;
+}
+
+
+static char *odict_write(char *d, const struct odict *o, bool array,
+			 int *err);
+
+
+static char *entry_write(char *d, const struct odict_entry *e, int *err)
+{
+	int n;
+
+	switch (e->type) {
+
+	case ODICT_OBJECT:
+		return odict_write(d, e->u.odict, false, err);
+
+	case ODICT_ARRAY:
+		return odict_write(d, e->u.odict, true, err);
+
+	case ODICT_INT:
+		return int_write(d, e->u.integer);
+
+	case ODICT_DOUBLE:
+		n = re_snprintf(d, DBL_MAXLEN, "%f", e->u.dbl);
+		if (n < 0) {
+			*err = ENOMEM;
+			return d;
+		}
+		return d + n;
+
+	case ODICT_STRING:
+		return str_write(d, e->u.str);
+
+	case ODICT_BOOL:
+		if (e->u.boolean) {
+			memcpy(d, "true", 4);
+			return d + 4;
+		}
+		memcpy(d, "false", 5);
+		return d + 5;
+
+	case ODICT_NULL:
+		memcpy(d, "null", 4);
+		return d + 4;
+
+	default:
+		re_fprintf(stderr, "json: unsupported type %d\n", e->type);
+		*err = EINVAL;
+		return d;
+	}
+}
+
+
+static char *odict_write(char *d, const struct odict *o, bool array,
+			 int *err)
+{
+	struct le *le;
+
+	if (!o)
+		return d;
+
+	*d++ = array ? '[' : '{';
+
+	for (le=o->lst.head; le && !*err; le=le->next) {
+
+		const struct odict_entry *e = le->data;
+
+		if (!array) {
+			d = str_write(d, e->key);
+			*d++ = ':';
+		}
+
+		d = entry_write(d, e, err);
+
+		if (le->next)
+			*d++ = ',';
+	}
+
+	*d++ = array ? ']' : '}';
+
+	return d;
+}
+
+
+/**
+ * Encode an ordered dictionary as JSON directly into a memory buffer
+ *
+ * The output is identical to json_encode_odict(), but the buffer is
+ * pre-sized in one pass and written without the printf machinery.
+ *
+ * @param mb Memory buffer, written at the current position
+ * @param o  Ordered dictionary
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int json_encode_odict_mbuf(struct mbuf *mb, const struct odict *o)
+{
+	size_t size;
+	char *start, *end;
+	int err = 0;
+
+	if (!mb)
+		return EINVAL;
+
+	if (!o)
+		return 0;
+
+	/* one spare byte for the NUL written by re_snprintf() */
+	size = odict_size(o, false) + 1;
+
+	if (mb->pos + size > mb->size) {
+		err = mbuf_resize(mb, mb->pos + size);
+		if (err)
+			return err;
+	}
+
+	start = (char *)mbuf_buf(mb);
+	end   = odict_write(start, o, false, &err);
+	if (err)
+		return err;
+
+	mb->pos += end - start;
+	mb->end  = max(mb->end, mb->pos);
+
+	return 0;
+}
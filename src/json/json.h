@@ -0,0 +1,14 @@
+/**
+ * @file json.h  JSON -- Internal API
+ *
+ * Copyright (C) 2010 - 2015 Creytiv.com
+ */
+
+
+/* Powers of five for number decoding */
+enum {
+	JSON_POW5_MIN = -342,
+	JSON_POW5_MAX =  308,
+};
+
+extern const uint64_t json_pow5tab[];
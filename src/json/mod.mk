@@ -7,3 +7,5 @@
 SRCS	+= json/decode.c
 SRCS	+= json/decode_odict.c
 SRCS	+= json/encode.c
+SRCS	+= json/pow5.c
+SRCS	+= json/stream.c
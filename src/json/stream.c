@@ -0,0 +1,563 @@
+/**
+ * @file json/stream.c  Incremental (streaming) JSON decoder
+ *
+ * Copyright (C) 2010 - 2015 Creytiv.com
+ */
+
+#include <string.h>
+#include <re_types.h>
+#include <re_fmt.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_list.h>
+#include <re_hash.h>
+#include <re_odict.h>
+#include <re_json.h>
+
+
+enum {
+	TOK_SIZE = 256,
+};
+
+enum state {
+	ST_VALUE,          /* expecting a value                  */
+	ST_VALUE_OR_END,   /* after '[' -- value or ']'          */
+	ST_KEY,            /* after ',' in object -- key         */
+	ST_KEY_OR_END,     /* after '{' -- key or '}'            */
+	ST_COLON,          /* after key -- ':'                   */
+	ST_NEXT,           /* after value in container -- ',' or end */
+};
+
+enum lex {
+	LEX_NONE,
+	LEX_STRING,
+	LEX_LITERAL,
+};
+
+enum container {
+	CONT_OBJECT,
+	CONT_ARRAY,
+};
+
+/** Defines the streaming JSON decoder */
+struct json_stream {
+	struct mbuf *tok;       /**< Partial token spanning fragments     */
+	uint8_t *stack;         /**< Container type per nesting level    */
+	unsigned maxdepth;      /**< Maximum nesting depth               */
+	unsigned depth;         /**< Current nesting depth               */
+	enum state st;          /**< Parser state                        */
+	enum lex lex;           /**< Current token type                  */
+	bool esc;               /**< Last string character was backslash */
+	bool key;               /**< Current string is an object key     */
+	int err;                /**< Sticky error                        */
+	json_event_h *eh;       /**< Event handler                       */
+	void *arg;              /**< Handler argument                    */
+};
+
+
+static void destructor(void *data)
+{
+	struct json_stream *js = data;
+
+	mem_deref(js->tok);
+	mem_deref(js->stack);
+}
+
+
+static inline bool is_literal_char(char ch)
+{
+	return ('0' <= ch && ch <= '9') || ('a' <= ch && ch <= 'z') ||
+		ch == '-' || ch == '+' || ch == '.' || ch == 'E';
+}
+
+
+static bool is_number(const struct pl *pl)
+{
+	const char *p = pl->p, *end = pl->p + pl->l;
+
+	if (p < end && *p == '-')
+		++p;
+
+	if (p >= end)
+		return false;
+
+	if (*p == '0') {
+		++p;
+	}
+	else if ('1' <= *p && *p <= '9') {
+		while (p < end && '0' <= *p && *p <= '9')
+			++p;
+	}
+	else
+		return false;
+
+	if (p < end && *p == '.') {
+
+		const char *q = ++p;
+
+		while (p < end && '0' <= *p && *p <= '9')
+			++p;
+
+		if (p == q)
+			return false;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+
+		const char *q;
+
+		++p;
+		if (p < end && (*p == '+' || *p == '-'))
+			++p;
+
+		q = p;
+		while (p < end && '0' <= *p && *p <= '9')
+			++p;
+
+		if (p == q)
+			return false;
+	}
+
+	return p == end;
+}
+
+
+static inline int emit(struct json_stream *js, enum json_event ev,
+		       const struct pl *pl)
+{
+	if (!js->eh)
+		return 0;
+
+	return js->eh(ev, pl ? pl : &pl_null, js->arg);
+}
+
+
+static inline void value_done(struct json_stream *js)
+{
+	js->st = js->depth ? ST_NEXT : ST_VALUE;
+}
+
+
+static int push(struct json_stream *js, enum container c)
+{
+	if (js->depth >= js->maxdepth)
+		return EOVERFLOW;
+
+	js->stack[js->depth++] = c;
+
+	return 0;
+}
+
+
+static inline enum container top(const struct json_stream *js)
+{
+	return js->depth ? js->stack[js->depth - 1] : CONT_ARRAY;
+}
+
+
+static int literal(struct json_stream *js, const struct pl *pl)
+{
+	enum json_event ev;
+	int err;
+
+	if (!pl_strcmp(pl, "true"))
+		ev = JSON_EV_TRUE;
+	else if (!pl_strcmp(pl, "false"))
+		ev = JSON_EV_FALSE;
+	else if (!pl_strcmp(pl, "null"))
+		ev = JSON_EV_NULL;
+	else if (is_number(pl))
+		ev = JSON_EV_NUMBER;
+	else
+		return EBADMSG;
+
+	err = emit(js, ev, pl);
+	if (err)
+		return err;
+
+	value_done(js);
+
+	return 0;
+}
+
+
+static int string(struct json_stream *js, const struct pl *pl)
+{
+	int err;
+
+	if (js->key) {
+		err = emit(js, JSON_EV_KEY, pl);
+		js->st = ST_COLON;
+	}
+	else {
+		err = emit(js, JSON_EV_STRING, pl);
+		value_done(js);
+	}
+
+	return err;
+}
+
+
+/*
+ * Complete the current token. If parts of it were spilled from a
+ * previous fragment, the remainder is appended and the event is
+ * emitted from the spill buffer, otherwise directly from the input.
+ */
+static int token_end(struct json_stream *js, const char *p, size_t l)
+{
+	struct pl pl;
+	int err;
+
+	if (js->tok->end) {
+		if (l) {
+			err = mbuf_write_mem(js->tok, (const uint8_t *)p, l);
+			if (err)
+				return err;
+		}
+
+		pl.p = (const char *)js->tok->buf;
+		pl.l = js->tok->end;
+	}
+	else {
+		pl.p = p;
+		pl.l = l;
+	}
+
+	if (js->lex == LEX_STRING)
+		err = string(js, &pl);
+	else
+		err = literal(js, &pl);
+
+	js->lex = LEX_NONE;
+	js->tok->pos = js->tok->end = 0;
+
+	return err;
+}
+
+
+static int structural(struct json_stream *js, char ch)
+{
+	int err;
+
+	switch (ch) {
+
+	case '{':
+		if (js->st != ST_VALUE && js->st != ST_VALUE_OR_END)
+			return EBADMSG;
+
+		err = push(js, CONT_OBJECT);
+		if (err)
+			return err;
+
+		js->st = ST_KEY_OR_END;
+		return emit(js, JSON_EV_OBJECT_START, NULL);
+
+	case '[':
+		if (js->st != ST_VALUE && js->st != ST_VALUE_OR_END)
+			return EBADMSG;
+
+		err = push(js, CONT_ARRAY);
+		if (err)
+			return err;
+
+		js->st = ST_VALUE_OR_END;
+		return emit(js, JSON_EV_ARRAY_START, NULL);
+
+	case '}':
+		if (js->st != ST_KEY_OR_END &&
+		    !(js->st == ST_NEXT && top(js) == CONT_OBJECT))
+			return EBADMSG;
+
+		--js->depth;
+		value_done(js);
+		return emit(js, JSON_EV_OBJECT_END, NULL);
+
+	case ']':
+		if (js->st != ST_VALUE_OR_END &&
+		    !(js->st == ST_NEXT && top(js) == CONT_ARRAY))
+			return EBADMSG;
+
+		--js->depth;
+		value_done(js);
+		return emit(js, JSON_EV_ARRAY_END, NULL);
+
+	case ',':
+		if (js->st != ST_NEXT)
+			return EBADMSG;
+
+		js->st = top(js) == CONT_OBJECT ? ST_KEY : ST_VALUE;
+		return 0;
+
+	case ':':
+		if (js->st != ST_COLON)
+			return EBADMSG;
+
+		js->st = ST_VALUE;
+		return 0;
+
+	case '"':
+		if (js->st == ST_KEY || js->st == ST_KEY_OR_END)
+			js->key = true;
+		else if (js->st == ST_VALUE || js->st == ST_VALUE_OR_END)
+			js->key = false;
+		else
+			return EBADMSG;
+
+		js->lex = LEX_STRING;
+		js->esc = false;
+		return 0;
+
+	default:
+		if (js->st != ST_VALUE && js->st != ST_VALUE_OR_END)
+			return EBADMSG;
+
+		if (ch != '-' && !('0' <= ch && ch <= '9') &&
+		    ch != 't' && ch != 'f' && ch != 'n')
+			return EBADMSG;
+
+		js->lex = LEX_LITERAL;
+		return 0;
+	}
+}
+
+
+static int feed(struct json_stream *js, const char *p, size_t len)
+{
+	const char *end = p + len;
+	const char *start = p;   /* start of current token in this fragment */
+	int err;
+
+	while (p < end) {
+
+		if (js->lex == LEX_STRING) {
+
+			bool esc = js->esc;
+
+			for (; p < end; ++p) {
+
+				if (esc)
+					esc = false;
+				else if (*p == '\\')
+					esc = true;
+				else if (*p == '"')
+					break;
+			}
+
+			js->esc = esc;
+
+			if (p == end)
+				break;
+
+			err = token_end(js, start, p - start);
+			if (err)
+				return err;
+
+			++p;
+			continue;
+		}
+		else if (js->lex == LEX_LITERAL) {
+
+			while (p < end && is_literal_char(*p))
+				++p;
+
+			if (p == end)
+				break;
+
+			err = token_end(js, start, p - start);
+			if (err)
+				return err;
+
+			continue;
+		}
+
+		switch (*p) {
+
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+			++p;
+			continue;
+
+		default:
+			break;
+		}
+
+		err = structural(js, *p);
+		if (err)
+			return err;
+
+		/* strings start after the quote, literals at the char */
+		start = (js->lex == LEX_STRING) ? p + 1 : p;
+		if (js->lex != LEX_LITERAL)
+			++p;
+	}
+
+	/* spill the incomplete token until the next fragment arrives */
+	if (js->lex != LEX_NONE && end > start)
+		return mbuf_write_mem(js->tok, (const uint8_t *)start,
+				      end - start);
+
+	return 0;
+}
+
+
+/**
+ * Allocate a streaming JSON decoder
+ *
+ * The decoder can be fed with arbitrary fragments of one or more
+ * concatenated JSON texts, and calls the event handler for each token.
+ * Keys, strings and numbers are passed as raw (still escaped) views
+ * into the input, no memory is allocated per token.
+ *
+ * @param jsp      Pointer to allocated streaming decoder
+ * @param maxdepth Maximum nesting depth
+ * @param eh       Event handler
+ * @param arg      Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int json_stream_alloc(struct json_stream **jsp, unsigned maxdepth,
+		      json_event_h *eh, void *arg)
+{
+	struct json_stream *js;
+	int err = 0;
+
+	if (!jsp || !maxdepth)
+		return EINVAL;
+
+	js = mem_zalloc(sizeof(*js), destructor);
+	if (!js)
+		return ENOMEM;
+
+	js->tok   = mbuf_alloc(TOK_SIZE);
+	js->stack = mem_alloc(maxdepth, NULL);
+	if (!js->tok || !js->stack) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	js->maxdepth = maxdepth;
+	js->eh       = eh;
+	js->arg      = arg;
+
+ out:
+	if (err)
+		mem_deref(js);
+	else
+		*jsp = js;
+
+	return err;
+}
+
+
+/**
+ * Feed a fragment of JSON text to the streaming decoder
+ *
+ * @param js  Streaming JSON decoder
+ * @param str JSON text fragment
+ * @param len Length of fragment
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int json_stream_feed(struct json_stream *js, const char *str, size_t len)
+{
+	if (!js || (!str && len))
+		return EINVAL;
+
+	if (js->err)
+		return js->err;
+
+	js->err = feed(js, str, len);
+
+	return js->err;
+}
+
+
+/**
+ * Feed the remaining bytes of a memory buffer to the streaming decoder
+ *
+ * @param js Streaming JSON decoder
+ * @param mb Memory buffer, the position is advanced to the end
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int json_stream_decode(struct json_stream *js, struct mbuf *mb)
+{
+	int err;
+
+	if (!mb)
+		return EINVAL;
+
+	err = json_stream_feed(js, (const char *)mbuf_buf(mb),
+			       mbuf_get_left(mb));
+	if (err)
+		return err;
+
+	mb->pos = mb->end;
+
+	return 0;
+}
+
+
+/**
+ * Signal end of input to the streaming decoder. A pending top-level
+ * number is completed, and an error is returned if the input ended
+ * inside a value.
+ *
+ * @param js Streaming JSON decoder
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int json_stream_end(struct json_stream *js)
+{
+	if (!js)
+		return EINVAL;
+
+	if (js->err)
+		return js->err;
+
+	if (js->lex == LEX_LITERAL && js->tok->end) {
+		js->err = token_end(js, NULL, 0);
+		if (js->err)
+			return js->err;
+	}
+
+	if (js->lex != LEX_NONE || js->depth || js->st != ST_VALUE)
+		js->err = EBADMSG;
+
+	return js->err;
+}
+
+
+/**
+ * Reset the streaming decoder to its initial state
+ *
+ * @param js Streaming JSON decoder
+ */
+void json_stream_reset(struct json_stream *js)
+{
+	if (!js)
+		return;
+
+	js->depth = 0;
+	js->st    = ST_VALUE;
+	js->lex   = LEX_NONE;
+	js->esc   = false;
+	js->key   = false;
+	js->err   = 0;
+	mbuf_rewind(js->tok);
+}
+
+
+/**
+ * Get the current nesting depth of the streaming decoder
+ *
+ * @param js Streaming JSON decoder
+ *
+ * @return Nesting depth
+ */
+unsigned json_stream_depth(const struct json_stream *js)
+{
+	return js ? js->depth : 0;
+}
@@ -12,6 +12,27 @@
 #include "re_odict.h"
 
 
+/* Switch from linear search to the hash table */
+static int hash_upgrade(struct odict *o)
+{
+	struct le *le;
+	int err;
+
+	err = hash_alloc(&o->ht, o->hash_size);
+	if (err)
+		return err;
+
+	for (le = o->lst.head; le; le = le->next) {
+
+		struct odict_entry *e = le->data;
+
+		hash_append(o->ht, hash_fast_str(e->key), &e->he, e);
+	}
+
+	return 0;
+}
+
+
 static void destructor(void *arg)
 {
 	struct odict_entry *e = arg;
@@ -95,8 +116,16 @@ int odict_entry_add(struct odict *o, const char *key,
 	if (err)
 		goto out;
 
+	if (!o->ht && list_count(&o->lst) >= ODICT_HASH_MIN) {
+		err = hash_upgrade(o);
+		if (err)
+			goto out;
+	}
+
 	list_append(&o->lst, &e->le, e);
-	hash_append(o->ht, hash_fast_str(e->key), &e->he, e);
+
+	if (o->ht)
+		hash_append(o->ht, hash_fast_str(e->key), &e->he, e);
 
  out:
 	if (err)
@@ -24,7 +24,6 @@ static void destructor(void *arg)
 int odict_alloc(struct odict **op, uint32_t hash_size)
 {
 	struct odict *o;
-	int err;
 
 	if (!op || !hash_size)
 		return EINVAL;
@@ -33,17 +32,12 @@ int odict_alloc(struct odict **op, uint32_t hash_size)
 	if (!o)
 		return ENOMEM;
 
-	err = hash_alloc(&o->ht, hash_valid_size(hash_size));
-	if (err)
-		goto out;
+	/* the hash table is allocated when the dictionary grows */
+	o->hash_size = hash_valid_size(hash_size);
 
- out:
-	if (err)
-		mem_deref(o);
-	else
-		*op = o;
+	*op = o;
 
-	return err;
+	return 0;
 }
 
 
@@ -54,7 +48,10 @@ const struct odict_entry *odict_lookup(const struct odict *o, const char *key)
 	if (!o || !key)
 		return NULL;
 
-	le = list_head(hash_list(o->ht, hash_fast_str(key)));
+	if (o->ht)
+		le = list_head(hash_list(o->ht, hash_fast_str(key)));
+	else
+		le = list_head(&o->lst);
 
 	while (le) {
 		const struct odict_entry *e = le->data;
@@ -99,6 +99,9 @@ int rtcp_rtpfb_decode(struct mbuf *mb, struct rtcp_msg *msg)
 		}
 		break;
 
+	case RTCP_RTPFB_TWCC:
+		return rtcp_rtpfb_twcc_decode(mb, msg);
+
 	default:
 		DEBUG_NOTICE("unknown RTPFB fmt %d\n", msg->hdr.count);
 		break;
@@ -9,45 +9,200 @@
 #include <re_mem.h>
 #include <re_mbuf.h>
 #include <re_list.h>
-#include <re_hash.h>
 #include <re_sa.h>
 #include <re_rtp.h>
 #include "rtcp.h"
 
 
+/*
+ * The member table is an open addressing hash table with linear
+ * probing, sized at allocation time to twice the maximum number of
+ * members. Since consecutive RTP packets usually come from the same
+ * source, the last member found is checked before the table.
+ */
+
+
+/** Defines the RTP member table */
+struct rtp_members {
+	struct rtp_member **tabv;  /**< Open addressing table          */
+	struct rtp_member *last;   /**< Last member found              */
+	uint32_t mask;             /**< Table size - 1                 */
+	uint32_t shift;            /**< Shift for the hash value       */
+	uint32_t max;              /**< Maximum number of members      */
+	uint32_t count;            /**< Current number of members      */
+};
+
+
+static inline uint32_t home_slot(const struct rtp_members *mt, uint32_t src)
+{
+	/* Fibonacci hashing, the SSRC can be chosen by the peer */
+	return (uint32_t)(src * 0x9e3779b1U) >> mt->shift;
+}
+
+
+static void member_unlink(struct rtp_member *mbr)
+{
+	struct rtp_members *mt = mbr->mt;
+	uint32_t i, j;
+
+	if (!mt)
+		return;
+
+	for (i = home_slot(mt, mbr->src); mt->tabv[i] != mbr;
+	     i = (i + 1) & mt->mask)
+		;
+
+	mt->tabv[i] = NULL;
+
+	/* Shift back the following members of the probe sequence */
+	for (j = (i + 1) & mt->mask; mt->tabv[j]; j = (j + 1) & mt->mask) {
+
+		const uint32_t k = home_slot(mt, mt->tabv[j]->src);
+
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		mt->tabv[i] = mt->tabv[j];
+		mt->tabv[j] = NULL;
+		i = j;
+	}
+
+	if (mt->last == mbr)
+		mt->last = NULL;
+
+	--mt->count;
+	mbr->mt = NULL;
+}
+
+
 static void destructor(void *data)
 {
 	struct rtp_member *mbr = data;
 
-	hash_unlink(&mbr->le);
+	member_unlink(mbr);
 	mem_deref(mbr->s);
 }
 
 
-struct rtp_member *member_add(struct hash *ht, uint32_t src)
+static void members_destructor(void *data)
+{
+	struct rtp_members *mt = data;
+	uint32_t i;
+
+	for (i=0; i<=mt->mask; i++) {
+
+		struct rtp_member *mbr = mt->tabv[i];
+
+		if (!mbr)
+			continue;
+
+		mt->tabv[i] = NULL;
+		mbr->mt = NULL;
+		mem_deref(mbr);
+	}
+
+	mem_deref(mt->tabv);
+}
+
+
+int members_alloc(struct rtp_members **mtp, uint32_t max)
+{
+	struct rtp_members *mt;
+	uint32_t size = 2, bits = 1;
+
+	if (!mtp || !max)
+		return EINVAL;
+
+	while (size < 2 * max) {
+		size <<= 1;
+		++bits;
+	}
+
+	mt = mem_zalloc(sizeof(*mt), members_destructor);
+	if (!mt)
+		return ENOMEM;
+
+	mt->tabv = mem_zalloc(size * sizeof(*mt->tabv), NULL);
+	if (!mt->tabv) {
+		mem_deref(mt);
+		return ENOMEM;
+	}
+
+	mt->mask  = size - 1;
+	mt->shift = 32 - bits;
+	mt->max   = max;
+
+	*mtp = mt;
+
+	return 0;
+}
+
+
+struct rtp_member *member_add(struct rtp_members *mt, uint32_t src)
 {
 	struct rtp_member *mbr;
+	uint32_t i;
+
+	if (!mt || mt->count >= mt->max)
+		return NULL;
 
 	mbr = mem_zalloc(sizeof(*mbr), destructor);
 	if (!mbr)
 		return NULL;
 
-	hash_append(ht, src, &mbr->le, mbr);
+	for (i = home_slot(mt, src); mt->tabv[i]; i = (i + 1) & mt->mask)
+		;
+
+	mt->tabv[i] = mbr;
+	++mt->count;
+
 	mbr->src = src;
+	mbr->mt  = mt;
 
 	return mbr;
 }
 
 
-static bool hash_cmp_handler(struct le *le, void *arg)
+struct rtp_member *member_find(struct rtp_members *mt, uint32_t src)
 {
-	const struct rtp_member *mbr = le->data;
+	struct rtp_member *mbr;
+	uint32_t i;
+
+	if (!mt)
+		return NULL;
+
+	mbr = mt->last;
+	if (mbr && mbr->src == src)
+		return mbr;
+
+	for (i = home_slot(mt, src); (mbr = mt->tabv[i]);
+	     i = (i + 1) & mt->mask) {
 
-	return mbr->src == *(uint32_t *)arg;
+		if (mbr->src == src) {
+			mt->last = mbr;
+			return mbr;
+		}
+	}
+
+	return NULL;
 }
 
 
-struct rtp_member *member_find(struct hash *ht, uint32_t src)
+struct rtp_member *member_apply(const struct rtp_members *mt,
+				member_apply_h *ah, void *arg)
 {
-	return list_ledata(hash_lookup(ht, src, hash_cmp_handler, &src));
+	uint32_t i;
+
+	if (!mt || !ah)
+		return NULL;
+
+	for (i=0; i<=mt->mask; i++) {
+
+		struct rtp_member *mbr = mt->tabv[i];
+
+		if (mbr && ah(mbr, arg))
+			return mbr;
+	}
+
+	return NULL;
 }
@@ -11,6 +11,10 @@ SRCS	+= rtp/pkt.c
 SRCS	+= rtp/rr.c
 SRCS	+= rtp/rtcp.c
 SRCS	+= rtp/rtp.c
+SRCS	+= rtp/rtpext.c
+SRCS	+= rtp/rtx.c
+SRCS	+= rtp/sched.c
 SRCS	+= rtp/sdes.c
 SRCS	+= rtp/sess.c
 SRCS	+= rtp/source.c
+SRCS	+= rtp/twcc.c
@@ -252,6 +252,14 @@ int rtcp_msg_print(struct re_printf *pf, const struct rtcp_msg *msg)
 						  msg->r.fb.fci.gnackv[i].blp);
 			}
 		}
+		else if (msg->hdr.count == RTCP_RTPFB_TWCC) {
+			const struct twcc *twcc = msg->r.fb.fci.twcc;
+
+			err |= re_hprintf(pf, " TWCC seq=%u count=%u"
+					  " reftime=%d fbcount=%u",
+					  twcc->seq, twcc->count,
+					  twcc->reftime, twcc->fbcount);
+		}
 		break;
 
 	case RTCP_PSFB:
@@ -11,12 +11,14 @@ enum {
 	RTCP_SRC_SIZE  =   4,  /**< Size of Source field         */
 	RTCP_SR_SIZE   =  20,  /**< Size of Sender Information   */
 	RTCP_RR_SIZE   =  24,  /**< Size of Report Block         */
+	RTCP_RR_MAX    =  31,  /**< Maximum Report Blocks        */
 	RTCP_APP_SIZE  =   8,  /**< Size of Application packet   */
 	RTCP_FIR_SIZE  =   4,  /**< Size of FIR packet           */
 	RTCP_NACK_SIZE =   8,  /**< Size of NACK packet          */
 	RTCP_FB_SIZE   =   8,  /**< Size of Feedback packets     */
 	RTCP_MAX_SDES  = 255,  /**< Maximum text length for SDES */
 	RTCP_HEADROOM  =   4,  /**< Headroom in RTCP packets     */
+	RTCP_INTERVAL  = 5000, /**< Interval in [ms] between reports */
 };
 
 /** NTP Time */
@@ -25,22 +27,25 @@ struct ntp_time {
 	uint32_t lo;  /**< Fraction of seconds                    */
 };
 
-struct hash;
-
-/** Per-source state information */
+/**
+ * Per-source state information
+ *
+ * The fields updated for every received RTP packet come first, so they
+ * share a cache line.
+ */
 struct rtp_source {
-	struct sa rtp_peer;       /**< IP-address of the RTP source        */
 	uint16_t max_seq;         /**< Highest seq. number seen            */
 	uint32_t cycles;          /**< Shifted count of seq. number cycles */
 	uint32_t base_seq;        /**< Base seq number                     */
 	uint32_t bad_seq;         /**< Last 'bad' seq number + 1           */
 	uint32_t probation;       /**< Sequ. packets till source is valid  */
 	uint32_t received;        /**< Packets received                    */
-	uint32_t expected_prior;  /**< Packet expected at last interval    */
-	uint32_t received_prior;  /**< Packet received at last interval    */
 	int transit;              /**< Relative trans time for prev pkt    */
 	uint32_t jitter;          /**< Estimated jitter                    */
 	size_t rtp_rx_bytes;      /**< Number of RTP bytes received        */
+	uint32_t expected_prior;  /**< Packet expected at last interval    */
+	uint32_t received_prior;  /**< Packet received at last interval    */
+	struct sa rtp_peer;       /**< IP-address of the RTP source        */
 	uint64_t sr_recv;         /**< When the last SR was received       */
 	struct ntp_time last_sr;  /**< NTP Timestamp from last SR received */
 	uint32_t rtp_ts;          /**< RTP timestamp                       */
@@ -50,9 +55,9 @@ struct rtp_source {
 
 /** RTP Member */
 struct rtp_member {
-	struct le le;             /**< Hash-table element                  */
+	uint32_t src;             /**< Source - used for table lookup      */
 	struct rtp_source *s;     /**< RTP source state                    */
-	uint32_t src;             /**< Source - used for hash-table lookup */
+	struct rtp_members *mt;   /**< Member table                        */
 	int cum_lost;             /**< Cumulative number of packets lost   */
 	uint32_t jit;             /**< Jitter in [us]                      */
 	uint32_t rtt;             /**< Round-trip time in [us]             */
@@ -60,8 +65,15 @@ struct rtp_member {
 
 
 /* Member */
-struct rtp_member *member_add(struct hash *ht, uint32_t src);
-struct rtp_member *member_find(struct hash *ht, uint32_t src);
+struct rtp_members;
+
+typedef bool (member_apply_h)(struct rtp_member *mbr, void *arg);
+
+int members_alloc(struct rtp_members **mtp, uint32_t max);
+struct rtp_member *member_add(struct rtp_members *mt, uint32_t src);
+struct rtp_member *member_find(struct rtp_members *mt, uint32_t src);
+struct rtp_member *member_apply(const struct rtp_members *mt,
+				member_apply_h *ah, void *arg);
 
 /* Source */
 void source_init_seq(struct rtp_source *s, uint16_t seq);
@@ -86,6 +98,16 @@ int rtcp_psfb_sli_encode(struct mbuf *mb, uint16_t first, uint16_t number,
 int rtcp_rtpfb_decode(struct mbuf *mb, struct rtcp_msg *msg);
 int rtcp_psfb_decode(struct mbuf *mb, struct rtcp_msg *msg);
 
+/* Transport-wide Congestion Control */
+struct twcc_rec;
+
+int  rtcp_rtpfb_twcc_decode(struct mbuf *mb, struct rtcp_msg *msg);
+int  twcc_rec_alloc(struct twcc_rec **trp, struct rtp_sock *rs,
+		    uint8_t extid, uint32_t interval);
+void twcc_rec_rx(struct twcc_rec *tr, const struct rtp_header *hdr,
+		 const struct mbuf *mb);
+int  twcc_rec_debug(struct re_printf *pf, const struct twcc_rec *tr);
+
 /** NTP Time */
 struct timeval;
 void unix2ntp(struct ntp_time *ntp, const struct timeval *tv);
@@ -94,6 +116,16 @@ int  ntp_time_get(struct ntp_time *ntp);
 uint32_t ntp_compact(const struct ntp_time *ntp);
 uint64_t ntp_compact2us(uint32_t ntpc);
 
+/* RTP Retransmission */
+struct rtx;
+
+int  rtx_alloc(struct rtx **rtxp, uint32_t npkt, size_t maxmem);
+void rtx_set_stream(struct rtx *rtx, bool enabled, uint8_t pt, uint32_t ssrc);
+void rtx_store(struct rtx *rtx, const struct sa *dst, uint16_t seq,
+	       const struct mbuf *mb);
+void rtx_handle_nack(struct rtx *rtx, void *sock, const struct rtcp_msg *msg);
+void rtx_stats(const struct rtx *rtx, struct rtp_rtx_stat *stat);
+
 /* RTP Socket */
 struct rtcp_sess *rtp_rtcp_sess(const struct rtp_sock *rs);
 
@@ -118,3 +150,8 @@ void rtcp_sess_tx_rtp(struct rtcp_sess *sess, uint32_t ts,
 void rtcp_sess_rx_rtp(struct rtcp_sess *sess, uint16_t seq, uint32_t ts,
 		      uint32_t src, size_t payload_size,
 		      const struct sa *peer);
+void rtcp_sess_report(struct rtcp_sess *sess);
+
+/* RTCP Scheduler */
+void rtcp_sched_add(struct rtcp_sched *sched, struct le *le,
+		    struct rtcp_sess *sess);
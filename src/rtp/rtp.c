@@ -38,6 +38,8 @@ struct rtp_sock {
 	rtcp_recv_h *rtcph;     /**< RTCP Receive handler  */
 	void *arg;              /**< Handler argument      */
 	struct rtcp_sess *rtcp; /**< RTCP Session          */
+	struct rtx *rtx;        /**< Send history (opt.)   */
+	struct twcc_rec *twcc;  /**< TWCC recorder (opt.)  */
 	bool rtcp_mux;          /**< RTP/RTCP multiplexing */
 };
 
@@ -155,6 +157,8 @@ static void destructor(void *data)
 
 	/* Destroy RTCP Session now */
 	mem_deref(rs->rtcp);
+	mem_deref(rs->rtx);
+	mem_deref(rs->twcc);
 
 	mem_deref(rs->sock_rtp);
 	mem_deref(rs->sock_rtcp);
@@ -171,6 +175,10 @@ static void rtcp_recv_handler(const struct sa *src, struct mbuf *mb, void *arg)
 		/* handle internally first */
 		rtcp_handler(rs->rtcp, msg);
 
+		if (rs->rtx && msg->hdr.pt == RTCP_RTPFB &&
+		    msg->r.fb.ssrc_media == rs->enc.ssrc)
+			rtx_handle_nack(rs->rtx, rs->sock_rtp, msg);
+
 		/* then relay to application */
 		if (rs->rtcph)
 			rs->rtcph(src, msg, rs->arg);
@@ -210,6 +218,9 @@ static void udp_recv_handler(const struct sa *src, struct mbuf *mb, void *arg)
 				 hdr.ssrc, mbuf_get_left(mb), src);
 	}
 
+	if (rs->twcc)
+		twcc_rec_rx(rs->twcc, &hdr, mb);
+
 	if (rs->recvh)
 		rs->recvh(src, &hdr, mb, rs->arg);
 }
@@ -452,10 +463,123 @@ int rtp_send(struct rtp_sock *rs, const struct sa *dst, bool ext,
 
 	mb->pos = pos;
 
+	if (rs->rtx)
+		rtx_store(rs->rtx, dst, rs->enc.seq - 1, mb);
+
 	return udp_send(rs->sock_rtp, dst, mb);
 }
 
 
+/**
+ * Enable the send history, used to answer Generic NACKs (RFC 4585)
+ *
+ * @param rs     RTP Socket
+ * @param npkt   Number of sent packets to keep, 0 to disable
+ * @param maxmem Maximum number of bytes to keep (0 for no limit)
+ *
+ * @return 0 for success, otherwise errorcode
+ *
+ * @note Must be called before sending, not while another thread sends
+ */
+int rtp_rtx_enable(struct rtp_sock *rs, uint32_t npkt, size_t maxmem)
+{
+	struct rtx *rtx = NULL;
+	int err;
+
+	if (!rs)
+		return EINVAL;
+
+	if (npkt) {
+		err = rtx_alloc(&rtx, npkt, maxmem);
+		if (err)
+			return err;
+	}
+
+	mem_deref(rs->rtx);
+	rs->rtx = rtx;
+
+	return 0;
+}
+
+
+/**
+ * Resend NACKed packets as an RTX stream (RFC 4588)
+ *
+ * Without an RTX stream the packets are resent unmodified, which is
+ * not possible with SRTP since the receiver discards replayed packets.
+ *
+ * @param rs      RTP Socket
+ * @param enabled True to use the RTX payload format
+ * @param pt      RTX payload type
+ * @param ssrc    RTX synchronization source
+ *
+ * @return 0 for success, otherwise errorcode
+ */
+int rtp_rtx_set_stream(struct rtp_sock *rs, bool enabled, uint8_t pt,
+		       uint32_t ssrc)
+{
+	if (!rs || !rs->rtx || pt&~0x7f)
+		return EINVAL;
+
+	rtx_set_stream(rs->rtx, enabled, pt, ssrc);
+
+	return 0;
+}
+
+
+/**
+ * Get the retransmission statistics of an RTP Socket
+ *
+ * @param rs   RTP Socket
+ * @param stat Pointer to statistics, set on return
+ *
+ * @return 0 for success, otherwise errorcode
+ */
+int rtp_rtx_stats(const struct rtp_sock *rs, struct rtp_rtx_stat *stat)
+{
+	if (!rs || !rs->rtx || !stat)
+		return EINVAL;
+
+	rtx_stats(rs->rtx, stat);
+
+	return 0;
+}
+
+
+/**
+ * Enable Transport-wide Congestion Control feedback
+ *
+ * The arrival time of each received packet carrying the transport-wide
+ * sequence number header extension is recorded, and reported to the
+ * sender in RTCP feedback messages.
+ *
+ * @param rs       RTP Socket
+ * @param extid    Header extension identifier, 0 to disable
+ * @param interval Feedback interval in [ms]
+ *
+ * @return 0 for success, otherwise errorcode
+ */
+int rtp_twcc_enable(struct rtp_sock *rs, uint8_t extid, uint32_t interval)
+{
+	struct twcc_rec *tr = NULL;
+	int err;
+
+	if (!rs)
+		return EINVAL;
+
+	if (extid) {
+		err = twcc_rec_alloc(&tr, rs, extid, interval);
+		if (err)
+			return err;
+	}
+
+	mem_deref(rs->twcc);
+	rs->twcc = tr;
+
+	return 0;
+}
+
+
 /**
  * Get the RTP transport socket from an RTP/RTCP Socket
  *
@@ -593,6 +717,19 @@ int rtp_debug(struct re_printf *pf, const struct rtp_sock *rs)
 	err |= re_hprintf(pf, " Encode: seq=%u ssrc=0x%lx\n",
 			  rs->enc.seq, rs->enc.ssrc);
 
+	if (rs->rtx) {
+		struct rtp_rtx_stat stat;
+
+		rtx_stats(rs->rtx, &stat);
+
+		err |= re_hprintf(pf, " Retransmit: nack=%u served=%u"
+				  " miss=%u mem=%zu\n",
+				  stat.n_nack, stat.n_served, stat.n_miss,
+				  stat.mem);
+	}
+
+	err |= twcc_rec_debug(pf, rs->twcc);
+
 	if (rs->rtcp)
 		err |= rtcp_debug(pf, rs);
 
@@ -0,0 +1,296 @@
+/**
+ * @file rtpext.c  RTP Header Extensions (RFC 8285)
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_fmt.h>
+#include <re_mbuf.h>
+#include <re_list.h>
+#include <re_sa.h>
+#include <re_rtp.h>
+
+
+/*
+ * The decoder does not copy anything, the returned extension elements
+ * point into the buffer holding the RTP packet. The element data can
+ * be changed in place, e.g. when forwarding a packet.
+ */
+
+
+enum {
+	ONEBYTE_ID_STOP = 15,
+	EXT_HDR_SIZE    = 4,
+};
+
+
+static bool is_twobyte(uint16_t type)
+{
+	return (type & RTPEXT_TYPE_MASK) == RTPEXT_TYPE_TWOBYTE;
+}
+
+
+static int ext_block(uint8_t **pp, size_t *lenp, bool *twobyte,
+		     const struct rtp_header *hdr, const struct mbuf *mb)
+{
+	const size_t len = hdr->x.len * 4;
+
+	if (hdr->x.type == RTPEXT_TYPE_ONEBYTE)
+		*twobyte = false;
+	else if (is_twobyte(hdr->x.type))
+		*twobyte = true;
+	else
+		return ENOTSUP;
+
+	/* The buffer is positioned after the extension block */
+	if (mb->pos < RTP_HEADER_SIZE + EXT_HDR_SIZE + len)
+		return EINVAL;
+
+	*pp   = mb->buf + mb->pos - len;
+	*lenp = len;
+
+	return 0;
+}
+
+
+static int ext_next(struct rtpext *ext, uint8_t *p, size_t len, size_t *pos,
+		    bool twobyte)
+{
+	while (*pos < len) {
+
+		const uint8_t b = p[(*pos)++];
+		uint8_t id;
+		size_t l;
+
+		/* padding */
+		if (b == 0)
+			continue;
+
+		if (twobyte) {
+			if (*pos >= len)
+				return EBADMSG;
+
+			id = b;
+			l  = p[(*pos)++];
+		}
+		else {
+			id = b >> 4;
+			l  = (b & 0x0f) + 1;
+
+			if (id == 0 || id == ONEBYTE_ID_STOP)
+				return ENOENT;
+		}
+
+		if (*pos + l > len)
+			return EBADMSG;
+
+		ext->id   = id;
+		ext->len  = l;
+		ext->data = &p[*pos];
+
+		*pos += l;
+
+		return 0;
+	}
+
+	return ENOENT;
+}
+
+
+/**
+ * Decode the RTP header extension elements of a packet
+ *
+ * @param extv Array of extension elements to decode into
+ * @param extc Size of the array on input, number of elements on return
+ * @param hdr  Decoded RTP header
+ * @param mb   Buffer positioned at the payload, after rtp_decode()
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note The element data points into the buffer
+ */
+int rtpext_decode(struct rtpext *extv, size_t *extc,
+		  const struct rtp_header *hdr, const struct mbuf *mb)
+{
+	size_t len, pos = 0, n = 0;
+	bool twobyte;
+	uint8_t *p;
+	int err;
+
+	if (!extv || !extc || !hdr || !mb)
+		return EINVAL;
+
+	if (!hdr->ext) {
+		*extc = 0;
+		return 0;
+	}
+
+	err = ext_block(&p, &len, &twobyte, hdr, mb);
+	if (err)
+		return err;
+
+	for (;;) {
+		struct rtpext ext;
+
+		err = ext_next(&ext, p, len, &pos, twobyte);
+		if (err == ENOENT)
+			break;
+		else if (err)
+			return err;
+
+		if (n >= *extc)
+			return EOVERFLOW;
+
+		extv[n++] = ext;
+	}
+
+	*extc = n;
+
+	return 0;
+}
+
+
+/**
+ * Find an RTP header extension element by its local identifier
+ *
+ * @param ext Extension element, set on return
+ * @param hdr Decoded RTP header
+ * @param mb  Buffer positioned at the payload, after rtp_decode()
+ * @param id  Local identifier
+ *
+ * @return 0 if found, ENOENT if not found, otherwise errorcode
+ *
+ * @note The element data points into the buffer
+ */
+int rtpext_find(struct rtpext *ext, const struct rtp_header *hdr,
+		const struct mbuf *mb, uint8_t id)
+{
+	size_t len, pos = 0;
+	bool twobyte;
+	uint8_t *p;
+	int err;
+
+	if (!ext || !hdr || !mb)
+		return EINVAL;
+
+	if (!hdr->ext)
+		return ENOENT;
+
+	err = ext_block(&p, &len, &twobyte, hdr, mb);
+	if (err)
+		return err;
+
+	do {
+		err = ext_next(ext, p, len, &pos, twobyte);
+		if (err)
+			return err;
+
+	} while (ext->id != id);
+
+	return 0;
+}
+
+
+/**
+ * Encode the header of an RTP header extension block
+ *
+ * The length is written as zero and updated by rtpext_hdr_update()
+ * when all elements have been encoded.
+ *
+ * @param mb   Buffer to encode into
+ * @param type One-byte or two-byte header type
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rtpext_hdr_encode(struct mbuf *mb, uint16_t type)
+{
+	int err;
+
+	if (!mb)
+		return EINVAL;
+
+	if (type != RTPEXT_TYPE_ONEBYTE && !is_twobyte(type))
+		return EINVAL;
+
+	err  = mbuf_write_u16(mb, htons(type));
+	err |= mbuf_write_u16(mb, 0);
+
+	return err;
+}
+
+
+/**
+ * Encode one RTP header extension element
+ *
+ * @param mb   Buffer to encode into
+ * @param type One-byte or two-byte header type
+ * @param id   Local identifier
+ * @param len  Length of the element data
+ * @param data Element data
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rtpext_encode(struct mbuf *mb, uint16_t type, uint8_t id, size_t len,
+		  const uint8_t *data)
+{
+	int err;
+
+	if (!mb || (len && !data) || !id)
+		return EINVAL;
+
+	if (is_twobyte(type)) {
+		if (len > RTPEXT_LEN_MAX)
+			return EINVAL;
+
+		err  = mbuf_write_u8(mb, id);
+		err |= mbuf_write_u8(mb, (uint8_t)len);
+	}
+	else {
+		if (id >= ONEBYTE_ID_STOP || !len || len > 16)
+			return EINVAL;
+
+		err = mbuf_write_u8(mb, id << 4 | (uint8_t)(len - 1));
+	}
+
+	if (len)
+		err |= mbuf_write_mem(mb, data, len);
+
+	return err;
+}
+
+
+/**
+ * Pad an RTP header extension block and update its length
+ *
+ * @param mb    Buffer containing the extension block
+ * @param start Position of the extension block header in the buffer
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rtpext_hdr_update(struct mbuf *mb, size_t start)
+{
+	size_t len;
+	int err;
+
+	if (!mb || mb->pos < start + EXT_HDR_SIZE)
+		return EINVAL;
+
+	len = mb->pos - start - EXT_HDR_SIZE;
+
+	if (len & 3) {
+		err = mbuf_fill(mb, 0, 4 - (len & 3));
+		if (err)
+			return err;
+
+		len = mb->pos - start - EXT_HDR_SIZE;
+	}
+
+	if (len / 4 > 0xffff)
+		return EOVERFLOW;
+
+	mb->buf[start + 2] = (uint8_t)((len / 4) >> 8);
+	mb->buf[start + 3] = (uint8_t)(len / 4);
+
+	return 0;
+}
@@ -0,0 +1,387 @@
+/**
+ * @file rtx.c  RTP Retransmission (RFC 4585 and RFC 4588)
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_fmt.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_list.h>
+#include <re_sa.h>
+#include <re_sys.h>
+#include <re_lock.h>
+#include <re_udp.h>
+#include <re_rtp.h>
+#include "rtcp.h"
+
+
+#define DEBUG_MODULE "rtx"
+#define DEBUG_LEVEL 5
+#include <re_dbg.h>
+
+
+/*
+ * The send history is a ring of packet copies indexed by the sequence
+ * number. The sender thread stores every packet it sends, and the RTCP
+ * receive path looks up the sequence numbers reported lost by a Generic
+ * NACK and sends them again, either as they were or wrapped in the RTX
+ * payload format on a separate SSRC.
+ *
+ * The packets are copied since the caller owns the buffer passed
+ * to rtp_send() and usually re-uses it for the next packet.
+ */
+
+
+enum {
+	RTX_MAX_PACKETS = 16384,
+	RTX_OSN_SIZE    = 2,
+};
+
+
+/** Defines a packet in the send history */
+struct rtx_pkt {
+	struct mbuf *mb;   /**< Copy of the RTP packet              */
+	struct sa dst;     /**< Destination address                 */
+	size_t hdrm;       /**< Headroom in front of the RTP header */
+	uint16_t seq;      /**< Sequence number                     */
+	bool used;         /**< True if the slot holds a packet     */
+};
+
+/** Defines the RTP send history */
+struct rtx {
+	struct rtx_pkt *pktv;     /**< Packet ring                       */
+	uint32_t sz;              /**< Number of slots, power of two     */
+	uint16_t tail;            /**< Oldest sequence number in the ring*/
+	bool started;             /**< True if a packet was stored       */
+	size_t mem;               /**< Memory used by stored packets     */
+	size_t maxmem;            /**< Memory limit for stored packets   */
+	struct mbuf *mb;          /**< Transmit buffer                   */
+	struct lock *lock;        /**< Protects the ring and counters    */
+	struct rtp_rtx_stat stat; /**< Retransmission statistics         */
+
+	/* RTX stream (RFC 4588) */
+	bool fmt;                 /**< True to use the RTX payload format*/
+	uint8_t pt;               /**< RTX payload type                  */
+	uint32_t ssrc;            /**< RTX synchronization source        */
+	uint16_t seq;             /**< RTX sequence number               */
+};
+
+
+static inline struct rtx_pkt *pkt_slot(const struct rtx *rtx, uint16_t seq)
+{
+	return &rtx->pktv[seq & (rtx->sz - 1)];
+}
+
+
+static void pkt_release(struct rtx *rtx, struct rtx_pkt *pkt)
+{
+	if (pkt->mb)
+		rtx->mem -= pkt->mb->size;
+
+	pkt->mb   = mem_deref(pkt->mb);
+	pkt->used = false;
+}
+
+
+static void destructor(void *data)
+{
+	struct rtx *rtx = data;
+	uint32_t i;
+
+	for (i=0; i<rtx->sz; i++)
+		mem_deref(rtx->pktv[i].mb);
+
+	mem_deref(rtx->pktv);
+	mem_deref(rtx->mb);
+	mem_deref(rtx->lock);
+}
+
+
+/**
+ * Allocate a new RTP send history
+ *
+ * @param rtxp   Pointer to allocated send history
+ * @param npkt   Number of packets to keep
+ * @param maxmem Maximum number of bytes used for packets (0 for no limit)
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rtx_alloc(struct rtx **rtxp, uint32_t npkt, size_t maxmem)
+{
+	struct rtx *rtx;
+	int err;
+
+	if (!rtxp || !npkt || npkt > RTX_MAX_PACKETS)
+		return EINVAL;
+
+	rtx = mem_zalloc(sizeof(*rtx), destructor);
+	if (!rtx)
+		return ENOMEM;
+
+	rtx->sz = 1;
+	while (rtx->sz < npkt)
+		rtx->sz <<= 1;
+
+	rtx->maxmem = maxmem ? maxmem : (size_t)-1;
+	rtx->seq    = rand_u16() & 0x7fff;
+
+	rtx->pktv = mem_zalloc(rtx->sz * sizeof(*rtx->pktv), NULL);
+	rtx->mb   = mbuf_alloc(RTP_HEADER_SIZE + 1024);
+	if (!rtx->pktv || !rtx->mb) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = lock_alloc(&rtx->lock);
+
+ out:
+	if (err)
+		mem_deref(rtx);
+	else
+		*rtxp = rtx;
+
+	return err;
+}
+
+
+/**
+ * Set the RTX stream used for retransmissions
+ *
+ * @param rtx     RTP send history
+ * @param enabled True to use the RTX payload format, false to resend as is
+ * @param pt      RTX payload type
+ * @param ssrc    RTX synchronization source
+ */
+void rtx_set_stream(struct rtx *rtx, bool enabled, uint8_t pt, uint32_t ssrc)
+{
+	if (!rtx)
+		return;
+
+	lock_write_get(rtx->lock);
+
+	rtx->fmt  = enabled;
+	rtx->pt   = pt & 0x7f;
+	rtx->ssrc = ssrc;
+
+	lock_rel(rtx->lock);
+}
+
+
+/**
+ * Store a sent RTP packet in the send history
+ *
+ * @param rtx RTP send history
+ * @param dst Destination address
+ * @param seq Sequence number of the packet
+ * @param mb  Buffer containing the RTP packet, starting at the header
+ */
+void rtx_store(struct rtx *rtx, const struct sa *dst, uint16_t seq,
+	       const struct mbuf *mb)
+{
+	struct rtx_pkt *pkt;
+	size_t len;
+
+	if (!rtx || !dst || !mb)
+		return;
+
+	len = mbuf_get_left(mb);
+
+	lock_write_get(rtx->lock);
+
+	if (!rtx->started) {
+		rtx->tail    = seq;
+		rtx->started = true;
+	}
+	else if ((uint16_t)(seq - rtx->tail) >= rtx->sz) {
+		rtx->tail = seq - rtx->sz + 1;
+	}
+
+	pkt = pkt_slot(rtx, seq);
+	pkt_release(rtx, pkt);
+
+	/* evict the oldest packets until the new one fits */
+	while (rtx->mem + len > rtx->maxmem && rtx->tail != seq) {
+
+		struct rtx_pkt *old = pkt_slot(rtx, rtx->tail);
+
+		if (old->used && old->seq == rtx->tail)
+			pkt_release(rtx, old);
+
+		++rtx->tail;
+	}
+
+	if (rtx->mem + len > rtx->maxmem)
+		goto out;
+
+	pkt->mb = mbuf_alloc(len);
+	if (!pkt->mb)
+		goto out;
+
+	(void)mbuf_write_mem(pkt->mb, mbuf_buf(mb), len);
+
+	pkt->dst  = *dst;
+	pkt->hdrm = mb->pos;
+	pkt->seq  = seq;
+	pkt->used = true;
+
+	rtx->mem += pkt->mb->size;
+
+ out:
+	lock_rel(rtx->lock);
+}
+
+
+static size_t rtp_hdr_len(const uint8_t *p, size_t len)
+{
+	size_t hlen = RTP_HEADER_SIZE + (p[0] & 0x0f) * 4;
+
+	if (p[0] & 0x10) {
+
+		if (len < hlen + 4)
+			return 0;
+
+		hlen += 4 + (size_t)(p[hlen + 2] << 8 | p[hlen + 3]) * 4;
+	}
+
+	return len < hlen ? 0 : hlen;
+}
+
+
+/* RTX packet: original header on the RTX stream, then the OSN */
+static int rtx_encode(struct rtx *rtx, struct mbuf *mb,
+		      const struct rtx_pkt *pkt)
+{
+	const uint8_t *p = pkt->mb->buf;
+	const size_t len = pkt->mb->end;
+	uint8_t *hdr = mbuf_buf(mb);
+	size_t hlen;
+	int err;
+
+	hlen = rtp_hdr_len(p, len);
+	if (!hlen)
+		return EBADMSG;
+
+	err  = mbuf_write_mem(mb, p, hlen);
+	err |= mbuf_write_u16(mb, htons(pkt->seq));
+	err |= mbuf_write_mem(mb, p + hlen, len - hlen);
+	if (err)
+		return err;
+
+	hdr[1]  = (hdr[1] & 0x80) | rtx->pt;
+	hdr[2]  = rtx->seq >> 8;
+	hdr[3]  = rtx->seq & 0xff;
+	hdr[8]  = rtx->ssrc >> 24;
+	hdr[9]  = rtx->ssrc >> 16;
+	hdr[10] = rtx->ssrc >> 8;
+	hdr[11] = rtx->ssrc & 0xff;
+
+	++rtx->seq;
+
+	return 0;
+}
+
+
+static int retransmit(struct rtx *rtx, void *sock, const struct rtx_pkt *pkt)
+{
+	struct mbuf *mb = rtx->mb;
+	const size_t sz = pkt->hdrm + pkt->mb->end + RTX_OSN_SIZE;
+	int err;
+
+	if (mb->size < sz) {
+		err = mbuf_resize(mb, sz);
+		if (err)
+			return err;
+	}
+
+	/* keep the headroom of the original packet for transport helpers */
+	mb->pos = mb->end = pkt->hdrm;
+
+	if (rtx->fmt)
+		err = rtx_encode(rtx, mb, pkt);
+	else
+		err = mbuf_write_mem(mb, pkt->mb->buf, pkt->mb->end);
+	if (err)
+		return err;
+
+	mb->pos = pkt->hdrm;
+
+	return udp_send(sock, &pkt->dst, mb);
+}
+
+
+static void resend(struct rtx *rtx, void *sock, uint16_t seq)
+{
+	const struct rtx_pkt *pkt = pkt_slot(rtx, seq);
+	int err;
+
+	++rtx->stat.n_nack;
+
+	if (!pkt->used || pkt->seq != seq) {
+		++rtx->stat.n_miss;
+		return;
+	}
+
+	err = retransmit(rtx, sock, pkt);
+	if (err) {
+		DEBUG_INFO("resend seq=%u failed (%m)\n", seq, err);
+		return;
+	}
+
+	++rtx->stat.n_served;
+}
+
+
+/**
+ * Handle an incoming Generic NACK and resend the reported packets
+ *
+ * @param rtx  RTP send history
+ * @param sock Transport socket for RTP
+ * @param msg  RTCP Transport layer feedback message
+ */
+void rtx_handle_nack(struct rtx *rtx, void *sock, const struct rtcp_msg *msg)
+{
+	uint32_t i;
+
+	if (!rtx || !msg)
+		return;
+
+	if (msg->hdr.pt != RTCP_RTPFB || msg->hdr.count != RTCP_RTPFB_GNACK)
+		return;
+
+	lock_write_get(rtx->lock);
+
+	for (i=0; i<msg->r.fb.n; i++) {
+
+		const struct gnack *gn = &msg->r.fb.fci.gnackv[i];
+		int j;
+
+		resend(rtx, sock, gn->pid);
+
+		for (j=0; j<16; j++) {
+			if (gn->blp & (1 << j))
+				resend(rtx, sock, gn->pid + j + 1);
+		}
+	}
+
+	lock_rel(rtx->lock);
+}
+
+
+/**
+ * Get the retransmission statistics
+ *
+ * @param rtx  RTP send history
+ * @param stat Pointer to statistics, set on return
+ */
+void rtx_stats(const struct rtx *rtx, struct rtp_rtx_stat *stat)
+{
+	if (!rtx || !stat)
+		return;
+
+	lock_read_get(rtx->lock);
+	*stat = rtx->stat;
+	stat->mem = rtx->mem;
+	lock_rel(rtx->lock);
+}
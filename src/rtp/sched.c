@@ -0,0 +1,127 @@
+/**
+ * @file sched.c  Shared RTCP report scheduler
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <re_types.h>
+#include <re_fmt.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_list.h>
+#include <re_tmr.h>
+#include <re_sa.h>
+#include <re_rtp.h>
+#include "rtcp.h"
+
+
+/*
+ * The scheduler drives the reports of many RTCP sessions from a single
+ * timer. The report interval is divided into slots of one tick each,
+ * and every session is placed in one slot for its lifetime. Each tick
+ * sends the reports of the sessions in the current slot, so the reports
+ * are spread evenly over the interval.
+ */
+
+
+/** Defines a shared RTCP report scheduler */
+struct rtcp_sched {
+	struct tmr tmr;       /**< Tick timer                   */
+	struct list *slotv;   /**< Sessions per slot            */
+	uint32_t slotc;       /**< Number of slots              */
+	uint32_t cur;         /**< Current slot                 */
+	uint32_t next;        /**< Slot for the next session    */
+	uint32_t tick;        /**< Tick interval in [ms]        */
+};
+
+
+static void destructor(void *data)
+{
+	struct rtcp_sched *sched = data;
+
+	tmr_cancel(&sched->tmr);
+	mem_deref(sched->slotv);
+}
+
+
+static void tick_handler(void *arg)
+{
+	struct rtcp_sched *sched = arg;
+	struct le *le;
+
+	tmr_start(&sched->tmr, sched->tick, tick_handler, sched);
+
+	le = list_head(&sched->slotv[sched->cur]);
+	while (le) {
+		struct rtcp_sess *sess = le->data;
+
+		le = le->next;
+
+		rtcp_sess_report(sess);
+	}
+
+	sched->cur = (sched->cur + 1) % sched->slotc;
+}
+
+
+/**
+ * Allocate a shared RTCP report scheduler
+ *
+ * The scheduler must only be used by RTP sockets that are running in
+ * the same thread as the scheduler.
+ *
+ * @param schedp Pointer to allocated scheduler
+ * @param tick   Tick interval in [ms], must divide the report interval
+ *               of 5000 ms (e.g. 10, 20, 50 or 100)
+ *
+ * @return 0 for success, otherwise errorcode
+ */
+int rtcp_sched_alloc(struct rtcp_sched **schedp, uint32_t tick)
+{
+	struct rtcp_sched *sched;
+	uint32_t i;
+
+	/* the slots must add up to exactly one report interval */
+	if (!schedp || !tick || tick > RTCP_INTERVAL || RTCP_INTERVAL % tick)
+		return EINVAL;
+
+	sched = mem_zalloc(sizeof(*sched), destructor);
+	if (!sched)
+		return ENOMEM;
+
+	sched->tick  = tick;
+	sched->slotc = RTCP_INTERVAL / tick;
+
+	sched->slotv = mem_alloc(sched->slotc * sizeof(*sched->slotv), NULL);
+	if (!sched->slotv) {
+		mem_deref(sched);
+		return ENOMEM;
+	}
+
+	for (i=0; i<sched->slotc; i++)
+		list_init(&sched->slotv[i]);
+
+	tmr_start(&sched->tmr, tick, tick_handler, sched);
+
+	*schedp = sched;
+
+	return 0;
+}
+
+
+/**
+ * Add an RTCP session to the scheduler
+ *
+ * @param sched Shared RTCP report scheduler
+ * @param le    List element of the session
+ * @param sess  RTCP session
+ */
+void rtcp_sched_add(struct rtcp_sched *sched, struct le *le,
+		    struct rtcp_sess *sess)
+{
+	if (!sched || !le || le->list)
+		return;
+
+	list_append(&sched->slotv[sched->next], le, sess);
+
+	sched->next = (sched->next + 1) % sched->slotc;
+}
@@ -16,7 +16,6 @@
 #include <re_mem.h>
 #include <re_mbuf.h>
 #include <re_list.h>
-#include <re_hash.h>
 #include <re_tmr.h>
 #include <re_sa.h>
 #include <re_lock.h>
@@ -31,8 +30,8 @@
 
 /** RTP protocol values */
 enum {
-	RTCP_INTERVAL = 5000,  /**< Interval in [ms] between sending reports */
-	MAX_MEMBERS   = 8,
+	MAX_MEMBERS      = 64,
+	SDES_PERIOD      = 6,  /**< Reports per SDES with reduced-size RTCP */
 };
 
 /** RTP Transmit stats */
@@ -47,22 +46,28 @@ struct txstat {
 /** RTCP Session */
 struct rtcp_sess {
 	struct rtp_sock *rs;        /**< RTP Socket                          */
-	struct hash *members;       /**< Member table                        */
+	struct rtp_members *members; /**< Member table                       */
 	struct tmr tmr;             /**< Event sender timer                  */
 	char *cname;                /**< Canonical Name                      */
 	uint32_t memberc;           /**< Number of members                   */
 	uint32_t senderc;           /**< Number of senders                   */
 	uint32_t srate_tx;          /**< Transmit sampling rate              */
 	uint32_t srate_rx;          /**< Receive sampling rate               */
+	struct rtcp_sched *sched;   /**< Shared report scheduler (optional)  */
+	struct le le_sched;         /**< Scheduler list element              */
+	size_t sdes_size;           /**< Size of the last SDES packet        */
+	bool rsize;                 /**< Reduced-size RTCP (RFC 5506)        */
 
 	/* stats */
 	struct lock *lock;          /**< Lock for txstat                     */
 	struct txstat txstat;       /**< Local transmit statistics           */
+	struct rtcp_report_stats rstat; /**< Report statistics               */
 };
 
 
 /* Prototypes */
 static void schedule(struct rtcp_sess *sess);
+static void unschedule(struct rtcp_sess *sess);
 static int  send_bye_packet(struct rtcp_sess *sess);
 
 
@@ -73,10 +78,10 @@ static void sess_destructor(void *data)
 	if (sess->cname)
 		(void)send_bye_packet(sess);
 
-	tmr_cancel(&sess->tmr);
+	unschedule(sess);
 
+	mem_deref(sess->sched);
 	mem_deref(sess->cname);
-	hash_flush(sess->members);
 	mem_deref(sess->members);
 	mem_deref(sess->lock);
 }
@@ -252,7 +257,7 @@ int rtcp_sess_alloc(struct rtcp_sess **sessp, struct rtp_sock *rs)
 	if (err)
 		goto out;
 
-	err  = hash_alloc(&sess->members, MAX_MEMBERS);
+	err  = members_alloc(&sess->members, MAX_MEMBERS);
 	if (err)
 		goto out;
 
@@ -331,7 +336,79 @@ int rtcp_enable(struct rtcp_sess *sess, bool enabled, const char *cname)
 	if (enabled)
 		schedule(sess);
 	else
-		tmr_cancel(&sess->tmr);
+		unschedule(sess);
+
+	return 0;
+}
+
+
+/**
+ * Send the RTCP reports of an RTP socket from a shared scheduler
+ *
+ * @param rs    RTP Socket
+ * @param sched Shared RTCP report scheduler, NULL for a timer per session
+ *
+ * @return 0 for success, otherwise errorcode
+ */
+int rtcp_set_sched(struct rtp_sock *rs, struct rtcp_sched *sched)
+{
+	struct rtcp_sess *sess = rtp_rtcp_sess(rs);
+	bool running;
+
+	if (!sess)
+		return EINVAL;
+
+	running = tmr_isrunning(&sess->tmr) || sess->le_sched.list;
+
+	unschedule(sess);
+
+	mem_deref(sess->sched);
+	sess->sched = mem_ref(sched);
+
+	if (running)
+		schedule(sess);
+
+	return 0;
+}
+
+
+/**
+ * Enable Reduced-Size RTCP (RFC 5506)
+ *
+ * With reduced-size RTCP the SDES packet is only included in every
+ * few reports instead of in all of them. It must be negotiated with
+ * the peer, usually together with RTP/RTCP multiplexing.
+ *
+ * @param rs      RTP Socket
+ * @param enabled True to enable, false to disable
+ */
+void rtcp_enable_rsize(struct rtp_sock *rs, bool enabled)
+{
+	struct rtcp_sess *sess = rtp_rtcp_sess(rs);
+	if (!sess)
+		return;
+
+	sess->rsize = enabled;
+}
+
+
+/**
+ * Get the RTCP report statistics of an RTP socket
+ *
+ * @param rs    RTP Socket
+ * @param stats Report statistics, set on return
+ *
+ * @return 0 for success, otherwise errorcode
+ */
+int rtcp_report_stats(const struct rtp_sock *rs,
+		      struct rtcp_report_stats *stats)
+{
+	const struct rtcp_sess *sess = rtp_rtcp_sess(rs);
+
+	if (!sess || !stats)
+		return EINVAL;
+
+	*stats = sess->rstat;
 
 	return 0;
 }
@@ -356,47 +433,69 @@ static uint32_t calc_dlsr(uint64_t sr_recv)
 }
 
 
-static bool sender_apply_handler(struct le *le, void *arg)
+/** Report blocks of the senders */
+struct rr_enc {
+	struct rtcp_rr *rrv;
+	uint32_t n;
+	uint32_t max;
+};
+
+/** Report blocks of one RTCP packet */
+struct rr_chunk {
+	const struct rtcp_rr *rrv;
+	uint32_t n;
+};
+
+
+static bool sender_apply_handler(struct rtp_member *mbr, void *arg)
 {
-	struct rtp_member *mbr = le->data;
 	struct rtp_source *s = mbr->s;
-	struct mbuf *mb = arg;
-	struct rtcp_rr rr;
+	struct rr_enc *enc = arg;
+	struct rtcp_rr *rr;
 
 	if (!s)
 		return false;
 
-	/* Initialise the members */
-	rr.ssrc     = mbr->src;
-	rr.fraction = source_calc_fraction_lost(s);
-	rr.lost     = source_calc_lost(s);
-	rr.last_seq = s->cycles | s->max_seq;
-	rr.jitter   = s->jitter >> 4;
-	rr.lsr      = calc_lsr(&s->last_sr);
-	rr.dlsr     = calc_dlsr(s->sr_recv);
+	if (enc->n >= enc->max)
+		return true;
 
-	return 0 != rtcp_rr_encode(mb, &rr);
+	rr = &enc->rrv[enc->n++];
+
+	/* Initialise the members */
+	rr->ssrc     = mbr->src;
+	rr->fraction = source_calc_fraction_lost(s);
+	rr->lost     = source_calc_lost(s);
+	rr->last_seq = s->cycles | s->max_seq;
+	rr->jitter   = s->jitter >> 4;
+	rr->lsr      = calc_lsr(&s->last_sr);
+	rr->dlsr     = calc_dlsr(s->sr_recv);
+
+	return false;
 }
 
 
 static int encode_handler(struct mbuf *mb, void *arg)
 {
-	struct hash *members = arg;
+	const struct rr_chunk *chunk = arg;
+	uint32_t i;
+	int err = 0;
 
-	/* copy all report blocks */
-	if (hash_apply(members, sender_apply_handler, mb))
-		return ENOMEM;
+	for (i=0; i<chunk->n && !err; i++)
+		err = rtcp_rr_encode(mb, &chunk->rrv[i]);
 
-	return 0;
+	return err;
 }
 
 
 /** Create a Sender Report */
 static int mk_sr(struct rtcp_sess *sess, struct mbuf *mb)
 {
+	const uint32_t ssrc = rtp_sess_ssrc(sess->rs);
 	struct ntp_time ntp = {0, 0};
+	struct rr_enc enc = {NULL, 0, 0};
+	struct rr_chunk chunk;
 	struct txstat txstat;
-	uint32_t dur, rtp_ts = 0;
+	uint32_t dur, rtp_ts = 0, i;
 	int err;
 
 	err = ntp_time_get(&ntp);
@@ -413,11 +512,34 @@ static int mk_sr(struct rtcp_sess *sess, struct mbuf *mb)
 		rtp_ts = txstat.ts_ref + dur * sess->srate_tx / 1000;
 	}
 
-	err = rtcp_encode(mb, RTCP_SR, sess->senderc, rtp_sess_ssrc(sess->rs),
+	if (sess->senderc) {
+		enc.rrv = mem_alloc(sess->senderc * sizeof(*enc.rrv), NULL);
+		if (!enc.rrv)
+			return ENOMEM;
+
+		enc.max = sess->senderc;
+
+		(void)member_apply(sess->members, sender_apply_handler, &enc);
+	}
+
+	chunk.rrv = enc.rrv;
+	chunk.n   = min(enc.n, (uint32_t)RTCP_RR_MAX);
+
+	err = rtcp_encode(mb, RTCP_SR, chunk.n, ssrc,
 			  ntp.hi, ntp.lo, rtp_ts, txstat.psent, txstat.osent,
-			  encode_handler, sess->members);
-	if (err)
-		return err;
+			  encode_handler, &chunk);
+
+	/* the blocks that do not fit go in RR packets (RFC 3550 6.4.2) */
+	for (i=chunk.n; i<enc.n && !err; i+=chunk.n) {
+
+		chunk.rrv = &enc.rrv[i];
+		chunk.n   = min(enc.n - i, (uint32_t)RTCP_RR_MAX);
+
+		err = rtcp_encode(mb, RTCP_RR, chunk.n, ssrc,
+				  encode_handler, &chunk);
+	}
+
+	mem_deref(enc.rrv);
 
 	return err;
 }
@@ -441,6 +563,8 @@ static int mk_sdes(struct rtcp_sess *sess, struct mbuf *mb)
 static int send_rtcp_report(struct rtcp_sess *sess)
 {
 	struct mbuf *mb;
+	bool sdes;
+	size_t pos;
 	int err;
 
 	mb = mbuf_alloc(512);
@@ -449,14 +573,37 @@ static int send_rtcp_report(struct rtcp_sess *sess)
 
 	mb->pos = RTCP_HEADROOM;
 
-	err  = mk_sr(sess, mb);
-	err |= mk_sdes(sess, mb);
+	/* Reduced-size RTCP: SDES only in the first and every Nth report */
+	sdes = !sess->rsize || !sess->sdes_size ||
+		sess->rstat.n_reports % SDES_PERIOD == 0;
+
+	err = mk_sr(sess, mb);
 	if (err)
 		goto out;
 
+	pos = mb->pos;
+
+	if (sdes) {
+		err = mk_sdes(sess, mb);
+		if (err)
+			goto out;
+
+		sess->sdes_size = mb->pos - pos;
+	}
+
 	mb->pos = RTCP_HEADROOM;
 
 	err = rtcp_send(sess->rs, mb);
+	if (err)
+		goto out;
+
+	if (sdes)
+		++sess->rstat.n_sdes;
+	else
+		sess->rstat.bytes_saved += sess->sdes_size;
+
+	++sess->rstat.n_reports;
+	sess->rstat.bytes += mb->end - RTCP_HEADROOM;
 
  out:
 	mem_deref(mb);
@@ -494,20 +641,37 @@ static int send_bye_packet(struct rtcp_sess *sess)
 static void timeout(void *arg)
 {
 	struct rtcp_sess *sess = arg;
+
+	rtcp_sess_report(sess);
+
+	schedule(sess);
+}
+
+
+void rtcp_sess_report(struct rtcp_sess *sess)
+{
 	int err;
 
 	err = send_rtcp_report(sess);
 	if (err) {
 		DEBUG_WARNING("Send RTCP report failed: %m\n", err);
 	}
-
-	schedule(sess);
 }
 
 
 static void schedule(struct rtcp_sess *sess)
 {
-	tmr_start(&sess->tmr, RTCP_INTERVAL, timeout, sess);
+	if (sess->sched)
+		rtcp_sched_add(sess->sched, &sess->le_sched, sess);
+	else
+		tmr_start(&sess->tmr, RTCP_INTERVAL, timeout, sess);
+}
+
+
+static void unschedule(struct rtcp_sess *sess)
+{
+	tmr_cancel(&sess->tmr);
+	list_unlink(&sess->le_sched);
 }
 
 
@@ -622,9 +786,8 @@ int rtcp_stats(struct rtp_sock *rs, uint32_t ssrc, struct rtcp_stats *stats)
 }
 
 
-static bool debug_handler(struct le *le, void *arg)
+static bool debug_handler(struct rtp_member *mbr, void *arg)
 {
-	const struct rtp_member *mbr = le->data;
 	struct re_printf *pf = arg;
 	int err;
 
@@ -664,12 +827,19 @@ int rtcp_debug(struct re_printf *pf, const struct rtp_sock *rs)
 			  rtp_sess_ssrc(sess->rs), rtp_sess_ssrc(sess->rs),
 			  sess->srate_rx);
 
-	hash_apply(sess->members, debug_handler, pf);
+	member_apply(sess->members, debug_handler, pf);
 
 	lock_read_get(sess->lock);
 	err |= re_hprintf(pf, "  TX: packets=%u, octets=%u\n",
 			  sess->txstat.psent, sess->txstat.osent);
 	lock_rel(sess->lock);
 
+	err |= re_hprintf(pf, "  Reports: %u (sdes=%u) bytes=%llu"
+			  " saved=%llu%s%s\n",
+			  sess->rstat.n_reports, sess->rstat.n_sdes,
+			  sess->rstat.bytes, sess->rstat.bytes_saved,
+			  sess->rsize ? " rsize" : "",
+			  sess->sched ? " sched" : "");
+
 	return err;
 }
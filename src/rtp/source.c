@@ -104,30 +104,45 @@ int source_update_seq(struct rtp_source *s, uint16_t seq)
 }
 
 
-/* RFC 3550 A.8
- *
- * The inputs are:
+/**
+ * Update an RTP inter-arrival jitter estimate (RFC 3550 A.8)
  *
- *     rtp_ts:  the timestamp from the incoming RTP packet
- *     arrival: the current time in the same units.
+ * @param transit Relative transit time of the previous packet
+ * @param jitter  Jitter estimate, in timestamp units scaled by 16
+ * @param rtp_ts  The timestamp from the incoming RTP packet
+ * @param arrival The current time in the same units
  */
-void source_calc_jitter(struct rtp_source *s, uint32_t rtp_ts,
-			uint32_t arrival)
+void rtp_jitter_calc(int *transit, uint32_t *jitter, uint32_t rtp_ts,
+		     uint32_t arrival)
 {
-	const int transit = arrival - rtp_ts;
-	int d = transit - s->transit;
+	const int t = arrival - rtp_ts;
+	int d = t - *transit;
 
-	if (!s->transit) {
-		s->transit = transit;
+	if (!*transit) {
+		*transit = t;
 		return;
 	}
 
-	s->transit = transit;
+	*transit = t;
 
 	if (d < 0)
 		d = -d;
 
-	s->jitter += d - ((s->jitter + 8) >> 4);
+	*jitter += d - ((*jitter + 8) >> 4);
+}
+
+
+/* RFC 3550 A.8
+ *
+ * The inputs are:
+ *
+ *     rtp_ts:  the timestamp from the incoming RTP packet
+ *     arrival: the current time in the same units.
+ */
+void source_calc_jitter(struct rtp_source *s, uint32_t rtp_ts,
+			uint32_t arrival)
+{
+	rtp_jitter_calc(&s->transit, &s->jitter, rtp_ts, arrival);
 }
 
 
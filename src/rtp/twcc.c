@@ -0,0 +1,599 @@
+/**
+ * @file twcc.c  Transport-wide Congestion Control feedback
+ *
+ * Copyright (C) 2010 Creytiv.com
+ *
+ * Ref: draft-holmer-rmcat-transport-wide-cc-extensions-01
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_fmt.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_list.h>
+#include <re_tmr.h>
+#include <re_sa.h>
+#include <re_rtp.h>
+#include "rtcp.h"
+
+
+#define DEBUG_MODULE "twcc"
+#define DEBUG_LEVEL 5
+#include <re_dbg.h>
+
+
+/*
+ * The receiver records the arrival time of every packet carrying the
+ * transport-wide sequence number header extension in a ring indexed
+ * by the sequence number. On every interval all packets recorded since
+ * the previous feedback are reported to the sender.
+ */
+
+
+enum {
+	TWCC_SIZE       = 2048,  /**< Number of packets in ring, power of 2 */
+	TWCC_MAX_STATUS = 1024,  /**< Maximum packets per feedback message */
+	TWCC_FCI_SIZE   = 8,     /**< Size of the fixed FCI fields         */
+	TWCC_DELTA_US   = 250,   /**< Receive delta unit in [us]           */
+	TWCC_REF_US     = 64000, /**< Reference time unit in [us]          */
+	TWCC_RUN_MAX    = 0x1fff,
+};
+
+/** Packet status symbols */
+enum twcc_sym {
+	SYM_NOT_RECEIVED = 0,
+	SYM_SMALL_DELTA  = 1,
+	SYM_LARGE_DELTA  = 2,
+};
+
+/** Transport-wide CC recorder */
+struct twcc_rec {
+	struct tmr tmr;           /**< Feedback timer                    */
+	struct rtp_sock *rs;      /**< Parent RTP socket                 */
+	uint64_t *arrv;           /**< Arrival times in [us], 0 if lost  */
+	uint64_t epoch;           /**< Time of the first packet in [us]  */
+	uint32_t interval;        /**< Feedback interval in [ms]         */
+	uint32_t ssrc_media;      /**< SSRC of the last recorded packet  */
+	uint16_t base;            /**< First unreported sequence number  */
+	uint16_t end;             /**< Highest sequence number + 1       */
+	uint8_t extid;            /**< Header extension identifier       */
+	uint8_t fbcount;          /**< Feedback packet count             */
+	bool started;             /**< True if a packet was recorded     */
+
+	/* stats */
+	uint32_t n_fb;            /**< Feedback messages sent            */
+	uint32_t n_late;          /**< Packets arrived after feedback    */
+};
+
+/** One feedback message to be encoded */
+struct twcc_fb {
+	uint16_t seq;
+	uint16_t n;
+	int32_t reftime;
+	uint8_t fbcount;
+	uint8_t symv[TWCC_MAX_STATUS];
+	int16_t deltav[TWCC_MAX_STATUS];
+};
+
+typedef int (sym_h)(enum twcc_sym sym, void *arg);
+
+
+static int chunks_walk(const uint8_t *p, size_t len, uint16_t count,
+		       size_t *used, sym_h *h, void *arg)
+{
+	size_t pos = 0;
+	uint32_t n = 0;
+	int err;
+
+	while (n < count) {
+
+		uint16_t chunk;
+		uint32_t i, k;
+
+		if (pos + 2 > len)
+			return EBADMSG;
+
+		chunk = p[pos] << 8 | p[pos + 1];
+		pos += 2;
+
+		if (!(chunk & 0x8000)) {
+			/* run length chunk */
+			const enum twcc_sym sym = chunk >> 13 & 0x3;
+
+			k = min((uint32_t)(chunk & TWCC_RUN_MAX), count - n);
+
+			for (i=0; i<k; i++) {
+				err = h(sym, arg);
+				if (err)
+					return err;
+			}
+		}
+		else if (!(chunk & 0x4000)) {
+			/* status vector chunk, 14 one-bit symbols */
+			k = min(14U, count - n);
+
+			for (i=0; i<k; i++) {
+				err = h(chunk >> (13 - i) & 0x1, arg);
+				if (err)
+					return err;
+			}
+		}
+		else {
+			/* status vector chunk, 7 two-bit symbols */
+			k = min(7U, count - n);
+
+			for (i=0; i<k; i++) {
+				err = h(chunk >> (12 - 2*i) & 0x3, arg);
+				if (err)
+					return err;
+			}
+		}
+
+		n += k;
+	}
+
+	*used = pos;
+
+	return 0;
+}
+
+
+static int delta_size_handler(enum twcc_sym sym, void *arg)
+{
+	size_t *sz = arg;
+
+	switch (sym) {
+
+	case SYM_NOT_RECEIVED:                 break;
+	case SYM_SMALL_DELTA:  *sz += 1;       break;
+	case SYM_LARGE_DELTA:  *sz += 2;       break;
+	default:               return EBADMSG;
+	}
+
+	return 0;
+}
+
+
+static void twcc_destructor(void *data)
+{
+	struct twcc *twcc = data;
+
+	mem_deref(twcc->chunks);
+	mem_deref(twcc->deltas);
+}
+
+
+/**
+ * Decode an RTCP Transport-wide Congestion Control feedback message
+ *
+ * @param mb  Buffer to decode
+ * @param msg RTCP Message to decode into
+ *
+ * @return 0 for success, otherwise errorcode
+ */
+int rtcp_rtpfb_twcc_decode(struct mbuf *mb, struct rtcp_msg *msg)
+{
+	struct twcc *twcc;
+	size_t sz, start, nchunks, ndeltas = 0;
+	uint32_t v;
+	int err;
+
+	sz = msg->r.fb.n * 4;
+	if (sz < TWCC_FCI_SIZE || mbuf_get_left(mb) < sz)
+		return EBADMSG;
+
+	twcc = mem_zalloc(sizeof(*twcc), twcc_destructor);
+	if (!twcc)
+		return ENOMEM;
+
+	msg->r.fb.fci.twcc = twcc;
+
+	start = mb->pos;
+
+	twcc->seq   = ntohs(mbuf_read_u16(mb));
+	twcc->count = ntohs(mbuf_read_u16(mb));
+	v = ntohl(mbuf_read_u32(mb));
+
+	/* 24-bit signed reference time */
+	twcc->reftime = (int32_t)(v & 0xffffff00) >> 8;
+	twcc->fbcount = v & 0xff;
+
+	sz -= TWCC_FCI_SIZE;
+
+	err = chunks_walk(mbuf_buf(mb), sz, twcc->count, &nchunks,
+			  delta_size_handler, &ndeltas);
+	if (err)
+		return err;
+
+	if (nchunks + ndeltas > sz)
+		return EBADMSG;
+
+	twcc->chunks = mbuf_alloc_ref(mb);
+	twcc->deltas = mbuf_alloc_ref(mb);
+	if (!twcc->chunks || !twcc->deltas)
+		return ENOMEM;
+
+	twcc->chunks->end = twcc->chunks->pos + nchunks;
+	twcc->deltas->pos = twcc->chunks->end;
+	twcc->deltas->end = twcc->deltas->pos + ndeltas;
+
+	mb->pos = start + msg->r.fb.n * 4;
+
+	return 0;
+}
+
+
+struct apply_state {
+	struct mbuf deltas;
+	int64_t arrival;
+	uint16_t seq;
+	rtcp_twcc_h *h;
+	void *arg;
+};
+
+
+static int apply_handler(enum twcc_sym sym, void *arg)
+{
+	struct apply_state *st = arg;
+	struct mbuf *mb = &st->deltas;
+	bool received = true;
+
+	switch (sym) {
+
+	case SYM_SMALL_DELTA:
+		if (mbuf_get_left(mb) < 1)
+			return EBADMSG;
+
+		st->arrival += mbuf_read_u8(mb) * TWCC_DELTA_US;
+		break;
+
+	case SYM_LARGE_DELTA:
+		if (mbuf_get_left(mb) < 2)
+			return EBADMSG;
+
+		st->arrival += (int16_t)ntohs(mbuf_read_u16(mb)) *
+			TWCC_DELTA_US;
+		break;
+
+	case SYM_NOT_RECEIVED:
+		received = false;
+		break;
+
+	default:
+		return EBADMSG;
+	}
+
+	st->h(st->seq++, received, received ? st->arrival : 0, st->arg);
+
+	return 0;
+}
+
+
+/**
+ * Apply a handler to the status of each packet in a decoded
+ * Transport-wide Congestion Control feedback message
+ *
+ * The arrival time is in [us], relative to the same point in time
+ * for all feedback messages from the same receiver.
+ *
+ * @param twcc Decoded feedback message
+ * @param h    Handler called for each packet
+ * @param arg  Handler argument
+ *
+ * @return 0 for success, otherwise errorcode
+ */
+int rtcp_twcc_apply(const struct twcc *twcc, rtcp_twcc_h *h, void *arg)
+{
+	struct apply_state st;
+	size_t used;
+
+	if (!twcc || !twcc->chunks || !twcc->deltas || !h)
+		return EINVAL;
+
+	st.deltas  = *twcc->deltas;
+	st.arrival = (int64_t)twcc->reftime * TWCC_REF_US;
+	st.seq     = twcc->seq;
+	st.h       = h;
+	st.arg     = arg;
+
+	return chunks_walk(mbuf_buf(twcc->chunks),
+			   mbuf_get_left(twcc->chunks), twcc->count, &used,
+			   apply_handler, &st);
+}
+
+
+static int chunk_encode(struct mbuf *mb, const uint8_t *symv, size_t n,
+			size_t *used)
+{
+	uint16_t chunk;
+	size_t run = 1, k;
+	bool twobit = false;
+
+	while (run < n && run < TWCC_RUN_MAX && symv[run] == symv[0])
+		++run;
+
+	if (run >= 14 || run == n) {
+		chunk = (uint16_t)(symv[0] << 13 | run);
+		*used = run;
+		return mbuf_write_u16(mb, htons(chunk));
+	}
+
+	for (k=0; k<14 && k<n; k++) {
+		if (symv[k] > SYM_SMALL_DELTA)
+			twobit = true;
+	}
+
+	if (twobit) {
+		chunk = 0xc000;
+		for (k=0; k<7 && k<n; k++)
+			chunk |= symv[k] << (12 - 2*k);
+		*used = min(n, (size_t)7);
+	}
+	else {
+		chunk = 0x8000;
+		for (k=0; k<14 && k<n; k++)
+			chunk |= symv[k] << (13 - k);
+		*used = min(n, (size_t)14);
+	}
+
+	return mbuf_write_u16(mb, htons(chunk));
+}
+
+
+static int fb_encode_handler(struct mbuf *mb, void *arg)
+{
+	const struct twcc_fb *fb = arg;
+	size_t i, used;
+	int err;
+
+	err  = mbuf_write_u16(mb, htons(fb->seq));
+	err |= mbuf_write_u16(mb, htons(fb->n));
+	err |= mbuf_write_u32(mb, htonl((uint32_t)fb->reftime << 8 |
+					fb->fbcount));
+	if (err)
+		return err;
+
+	for (i=0; i<fb->n; i+=used) {
+		err = chunk_encode(mb, &fb->symv[i], fb->n - i, &used);
+		if (err)
+			return err;
+	}
+
+	for (i=0; i<fb->n && !err; i++) {
+
+		switch (fb->symv[i]) {
+
+		case SYM_SMALL_DELTA:
+			err = mbuf_write_u8(mb, (uint8_t)fb->deltav[i]);
+			break;
+
+		case SYM_LARGE_DELTA:
+			err = mbuf_write_u16(mb, htons(fb->deltav[i]));
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return err;
+}
+
+
+/* Collect the status of the unreported packets, starting at base */
+static bool fb_collect(struct twcc_rec *tr, struct twcc_fb *fb)
+{
+	const uint16_t count = tr->end - tr->base;
+	int64_t prev = 0;
+	bool ref = false;
+	uint16_t i;
+
+	fb->seq     = tr->base;
+	fb->fbcount = tr->fbcount;
+	fb->n       = 0;
+
+	for (i=0; i<count && i<TWCC_MAX_STATUS; i++) {
+
+		uint64_t *t = &tr->arrv[(uint16_t)(tr->base + i) &
+					(TWCC_SIZE - 1)];
+		int64_t delta;
+
+		if (!*t) {
+			fb->symv[i] = SYM_NOT_RECEIVED;
+			++fb->n;
+			continue;
+		}
+
+		if (!ref) {
+			const uint64_t rel = *t - tr->epoch;
+
+			fb->reftime = (int32_t)((rel / TWCC_REF_US) & 0x7fffff);
+			prev = (int64_t)fb->reftime * TWCC_REF_US;
+			ref  = true;
+		}
+
+		delta = ((int64_t)(*t - tr->epoch) - prev) / TWCC_DELTA_US;
+
+		if (delta >= 0 && delta <= 0xff)
+			fb->symv[i] = SYM_SMALL_DELTA;
+		else if (delta >= -0x8000 && delta <= 0x7fff)
+			fb->symv[i] = SYM_LARGE_DELTA;
+		else
+			break;  /* report it in the next message */
+
+		fb->deltav[i] = (int16_t)delta;
+		prev += delta * TWCC_DELTA_US;
+		*t = 0;
+		++fb->n;
+	}
+
+	/* nothing received, nothing to report */
+	if (!ref) {
+		for (i=0; i<fb->n; i++)
+			tr->arrv[(uint16_t)(tr->base + i) & (TWCC_SIZE-1)] = 0;
+
+		tr->base += fb->n;
+		return false;
+	}
+
+	return true;
+}
+
+
+static void twcc_send(struct twcc_rec *tr)
+{
+	struct twcc_fb *fb;
+	struct mbuf *mb;
+	int err = 0;
+
+	if (!tr->started || tr->base == tr->end)
+		return;
+
+	fb = mem_alloc(sizeof(*fb), NULL);
+	mb = mbuf_alloc(512);
+	if (!fb || !mb)
+		goto out;
+
+	while (tr->base != tr->end) {
+
+		if (!fb_collect(tr, fb))
+			continue;
+
+		mb->pos = mb->end = RTCP_HEADROOM;
+
+		err = rtcp_encode(mb, RTCP_RTPFB, RTCP_RTPFB_TWCC,
+				  rtp_sess_ssrc(tr->rs), tr->ssrc_media,
+				  fb_encode_handler, fb);
+		if (err)
+			break;
+
+		mb->pos = RTCP_HEADROOM;
+
+		err = rtcp_send(tr->rs, mb);
+		if (err) {
+			DEBUG_INFO("send feedback failed (%m)\n", err);
+		}
+
+		tr->base += fb->n;
+		++tr->fbcount;
+		++tr->n_fb;
+	}
+
+ out:
+	mem_deref(mb);
+	mem_deref(fb);
+}
+
+
+static void timeout(void *arg)
+{
+	struct twcc_rec *tr = arg;
+
+	tmr_start(&tr->tmr, tr->interval, timeout, tr);
+
+	twcc_send(tr);
+}
+
+
+static void rec_destructor(void *data)
+{
+	struct twcc_rec *tr = data;
+
+	tmr_cancel(&tr->tmr);
+	mem_deref(tr->arrv);
+}
+
+
+int twcc_rec_alloc(struct twcc_rec **trp, struct rtp_sock *rs,
+		   uint8_t extid, uint32_t interval)
+{
+	struct twcc_rec *tr;
+
+	if (!trp || !rs || !extid || !interval)
+		return EINVAL;
+
+	tr = mem_zalloc(sizeof(*tr), rec_destructor);
+	if (!tr)
+		return ENOMEM;
+
+	tr->arrv = mem_zalloc(TWCC_SIZE * sizeof(*tr->arrv), NULL);
+	if (!tr->arrv) {
+		mem_deref(tr);
+		return ENOMEM;
+	}
+
+	tr->rs       = rs;
+	tr->extid    = extid;
+	tr->interval = interval;
+
+	tmr_start(&tr->tmr, interval, timeout, tr);
+
+	*trp = tr;
+
+	return 0;
+}
+
+
+/**
+ * Record the arrival of an RTP packet
+ *
+ * @param tr  Transport-wide CC recorder
+ * @param hdr Decoded RTP header
+ * @param mb  Buffer positioned at the payload
+ */
+void twcc_rec_rx(struct twcc_rec *tr, const struct rtp_header *hdr,
+		 const struct mbuf *mb)
+{
+	struct rtpext ext;
+	uint64_t now;
+	uint16_t seq;
+
+	if (!tr || !hdr->ext)
+		return;
+
+	if (rtpext_find(&ext, hdr, mb, tr->extid) || ext.len != 2)
+		return;
+
+	now = tmr_jiffies_usec();
+	seq = ext.data[0] << 8 | ext.data[1];
+
+	if (!tr->started) {
+		tr->base    = seq;
+		tr->end     = seq;
+		tr->epoch   = now;
+		tr->started = true;
+	}
+
+	if ((uint16_t)(seq - tr->base) >= 0x8000) {
+		++tr->n_late;
+		return;
+	}
+
+	/* Report what we have before the ring wraps */
+	if ((uint16_t)(seq - tr->base) >= TWCC_SIZE) {
+
+		twcc_send(tr);
+
+		if ((uint16_t)(seq - tr->base) >= TWCC_SIZE) {
+			memset(tr->arrv, 0, TWCC_SIZE * sizeof(*tr->arrv));
+			tr->base = tr->end = seq;
+		}
+	}
+
+	tr->arrv[seq & (TWCC_SIZE - 1)] = now;
+	tr->ssrc_media = hdr->ssrc;
+
+	if ((uint16_t)(seq - tr->end) < 0x8000)
+		tr->end = seq + 1;
+}
+
+
+int twcc_rec_debug(struct re_printf *pf, const struct twcc_rec *tr)
+{
+	if (!tr)
+		return 0;
+
+	return re_hprintf(pf, " TWCC: extid=%u interval=%ums feedback=%u"
+			  " late=%u\n", tr->extid, tr->interval, tr->n_fb,
+			  tr->n_late);
+}
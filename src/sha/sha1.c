@@ -89,6 +89,11 @@ A million repetitions of "a"
 #include <string.h>
 #include <re_types.h>
 #include <re_sha.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#include <cpuid.h>
+#define SHA1_SHANI 1
+#endif
 
 void SHA1_Transform(uint32_t state[5], const uint8_t buffer[64]);
 
@@ -186,6 +191,153 @@ void SHA1_Transform(uint32_t state[5], const uint8_t buffer[64])
 }
 
 
+#ifdef SHA1_SHANI
+static bool have_shani(void)
+{
+	static int have = -1;
+
+	if (have < 0) {
+		unsigned int eax, ebx = 0, ecx, edx;
+
+		__builtin_cpu_init();
+
+		/* CPUID leaf 7, EBX bit 29 */
+		__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+
+		have = (ebx >> 29) & 1 &&
+			__builtin_cpu_supports("sse4.1") &&
+			__builtin_cpu_supports("ssse3");
+	}
+
+	return have > 0;
+}
+
+
+/* Four rounds with message schedule, for rounds 16-67 */
+#define SHANI_R(e_next, e_prev, m0, m1, m2, m3, f)		\
+	e_next = _mm_sha1nexte_epu32(e_next, m0);		\
+	e_prev = abcd;						\
+	m1 = _mm_sha1msg2_epu32(m1, m0);			\
+	abcd = _mm_sha1rnds4_epu32(abcd, e_next, f);		\
+	m3 = _mm_sha1msg1_epu32(m3, m0);			\
+	m2 = _mm_xor_si128(m2, m0);
+
+
+/* Hash blocks of 512 bits with the SHA extensions */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void transform_shani(uint32_t state[5], const uint8_t *data,
+			    size_t nblocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+					    0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e0_save, e1;
+	__m128i m0, m1, m2, m3;
+
+	abcd = _mm_loadu_si128((const __m128i *)(void *)state);
+	abcd = _mm_shuffle_epi32(abcd, 0x1b);
+	e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+	while (nblocks--) {
+
+		abcd_save = abcd;
+		e0_save = e0;
+
+		m0 = _mm_loadu_si128((const __m128i *)(const void *)data);
+		m1 = _mm_loadu_si128((const __m128i *)(const void *)
+				     (data + 16));
+		m2 = _mm_loadu_si128((const __m128i *)(const void *)
+				     (data + 32));
+		m3 = _mm_loadu_si128((const __m128i *)(const void *)
+				     (data + 48));
+		m0 = _mm_shuffle_epi8(m0, mask);
+		m1 = _mm_shuffle_epi8(m1, mask);
+		m2 = _mm_shuffle_epi8(m2, mask);
+		m3 = _mm_shuffle_epi8(m3, mask);
+
+		/* rounds 0-15 */
+		e0 = _mm_add_epi32(e0, m0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+		e1 = _mm_sha1nexte_epu32(e1, m1);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		m0 = _mm_sha1msg1_epu32(m0, m1);
+
+		e0 = _mm_sha1nexte_epu32(e0, m2);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		m1 = _mm_sha1msg1_epu32(m1, m2);
+		m0 = _mm_xor_si128(m0, m2);
+
+		e1 = _mm_sha1nexte_epu32(e1, m3);
+		e0 = abcd;
+		m0 = _mm_sha1msg2_epu32(m0, m3);
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		m2 = _mm_sha1msg1_epu32(m2, m3);
+		m1 = _mm_xor_si128(m1, m3);
+
+		/* rounds 16-67 */
+		SHANI_R(e0, e1, m0, m1, m2, m3, 0);
+		SHANI_R(e1, e0, m1, m2, m3, m0, 1);
+		SHANI_R(e0, e1, m2, m3, m0, m1, 1);
+		SHANI_R(e1, e0, m3, m0, m1, m2, 1);
+		SHANI_R(e0, e1, m0, m1, m2, m3, 1);
+		SHANI_R(e1, e0, m1, m2, m3, m0, 1);
+		SHANI_R(e0, e1, m2, m3, m0, m1, 2);
+		SHANI_R(e1, e0, m3, m0, m1, m2, 2);
+		SHANI_R(e0, e1, m0, m1, m2, m3, 2);
+		SHANI_R(e1, e0, m1, m2, m3, m0, 2);
+		SHANI_R(e0, e1, m2, m3, m0, m1, 2);
+		SHANI_R(e1, e0, m3, m0, m1, m2, 3);
+		SHANI_R(e0, e1, m0, m1, m2, m3, 3);
+
+		/* rounds 68-79 */
+		e1 = _mm_sha1nexte_epu32(e1, m1);
+		e0 = abcd;
+		m2 = _mm_sha1msg2_epu32(m2, m1);
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+		m3 = _mm_xor_si128(m3, m1);
+
+		e0 = _mm_sha1nexte_epu32(e0, m2);
+		e1 = abcd;
+		m3 = _mm_sha1msg2_epu32(m3, m2);
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+		e1 = _mm_sha1nexte_epu32(e1, m3);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+		e0 = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+
+		data += 64;
+	}
+
+	abcd = _mm_shuffle_epi32(abcd, 0x1b);
+	_mm_storeu_si128((__m128i *)(void *)state, abcd);
+	state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+#endif
+
+
+static void transform(uint32_t state[5], const uint8_t *data,
+		      size_t nblocks)
+{
+#ifdef SHA1_SHANI
+	if (have_shani()) {
+		transform_shani(state, data, nblocks);
+		return;
+	}
+#endif
+
+	while (nblocks--) {
+		SHA1_Transform(state, data);
+		data += 64;
+	}
+}
+
+
 /**
  * Initialize new context
  *
@@ -221,10 +373,9 @@ void SHA1_Update(SHA1_CTX* context, const void *p, size_t len)
 	context->count[1] += (uint32_t)(len >> 29);
 	if ((j + len) > 63) {
 		memcpy(&context->buffer[j], data, (i = 64-j));
-		SHA1_Transform(context->state, context->buffer);
-		for ( ; i + 63 < len; i += 64) {
-			SHA1_Transform(context->state, data + i);
-		}
+		transform(context->state, context->buffer, 1);
+		transform(context->state, data + i, (len - i) / 64);
+		i += (len - i) & ~(size_t)63;
 		j = 0;
 	}
 	else i = 0;
@@ -242,16 +393,21 @@ void SHA1_Final(uint8_t digest[SHA1_DIGEST_SIZE], SHA1_CTX* context)
 {
 	uint32_t i;
 	uint8_t  finalcount[8];
+	uint8_t  pad[64 + 8];
+	size_t   padlen;
 
 	for (i = 0; i < 8; i++) {
 		finalcount[i] = (uint8_t)((context->count[(i >= 4 ? 0 : 1)]
 					   >> ((3-(i & 3)) * 8) ) & 255);
 	}
-	SHA1_Update(context, (uint8_t *)"\200", 1);
-	while ((context->count[0] & 504) != 448) {
-		SHA1_Update(context, (uint8_t *)"\0", 1);
-	}
-	SHA1_Update(context, finalcount, 8); /* Should cause SHA1_Transform */
+
+	/* pad to 56 mod 64 bytes and append the length in one update */
+	i = (context->count[0] >> 3) & 63;
+	padlen = (i < 56) ? 56 - i : 120 - i;
+	pad[0] = 0x80;
+	memset(&pad[1], 0, padlen - 1);
+	memcpy(&pad[padlen], finalcount, 8);
+	SHA1_Update(context, pad, padlen + 8);
 	for (i = 0; i < SHA1_DIGEST_SIZE; i++) {
 		digest[i] = (uint8_t)
 			((context->state[i>>2] >> ((3-(i & 3)) * 8) ) & 255);
@@ -265,6 +421,6 @@ void SHA1_Final(uint8_t digest[SHA1_DIGEST_SIZE], SHA1_CTX* context)
 	memset(finalcount, 0, 8);	/* SWR */
 
 #ifdef SHA1HANDSOFF  /* make SHA1Transform overwrite its own static vars */
-	SHA1_Transform(context->state, context->buffer);
+	transform(context->state, context->buffer, 1);
 #endif
 }
@@ -0,0 +1,279 @@
+/**
+ * @file sha1_mb.c  Multi-buffer SHA-1
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_sha.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <emmintrin.h>
+#include <cpuid.h>
+#define SHA1_MB_SSE2 1
+#endif
+
+
+/*
+ * Several independent messages are hashed in parallel, one message per
+ * 32-bit lane of a SSE2 register. For short messages this is faster
+ * than hashing them one by one, except with the built-in SHA-1 on CPUs
+ * with the SHA extensions.
+ */
+
+
+enum {
+	LANES = 4,
+	BLOCK = 64,
+};
+
+
+static void sha1_one(uint8_t *md, const uint8_t *p, size_t len)
+{
+#ifdef USE_OPENSSL
+	SHA1(p, len, md);
+#else
+	SHA1_CTX ctx;
+
+	SHA1_Init(&ctx);
+	SHA1_Update(&ctx, p, len);
+	SHA1_Final(md, &ctx);
+#endif
+}
+
+
+#ifdef SHA1_MB_SSE2
+static bool use_x4(void)
+{
+#ifdef USE_OPENSSL
+	return true;
+#else
+	static int have_shani = -1;
+
+	if (have_shani < 0) {
+		unsigned int eax, ebx = 0, ecx, edx;
+
+		/* CPUID leaf 7, EBX bit 29 */
+		__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+
+		have_shani = (ebx >> 29) & 1;
+	}
+
+	return !have_shani;
+#endif
+}
+
+
+/* Per-lane message state */
+struct lane {
+	const uint8_t *p;      /**< Message data                  */
+	uint8_t *md;           /**< Digest output                 */
+	size_t nfull;          /**< Number of full data blocks    */
+	size_t nblk;           /**< Number of blocks with padding */
+	uint8_t tail[2*BLOCK]; /**< Padded last block(s)          */
+};
+
+
+static inline uint32_t rd32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+		(uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+
+static inline void wr32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+
+static void lane_init(struct lane *l, uint8_t *md, const uint8_t *p,
+		      size_t len)
+{
+	const size_t rem = len % BLOCK;
+	const uint64_t bits = (uint64_t)len << 3;
+	size_t tlen;
+
+	l->p     = p;
+	l->md    = md;
+	l->nfull = len / BLOCK;
+
+	tlen = (rem < BLOCK - 8) ? BLOCK : 2*BLOCK;
+	l->nblk = l->nfull + tlen / BLOCK;
+
+	memset(l->tail, 0, tlen);
+	if (rem)
+		memcpy(l->tail, p + len - rem, rem);
+	l->tail[rem] = 0x80;
+	wr32(&l->tail[tlen - 8], (uint32_t)(bits >> 32));
+	wr32(&l->tail[tlen - 4], (uint32_t)bits);
+}
+
+
+static inline const uint8_t *lane_block(const struct lane *l, size_t b)
+{
+	static const uint8_t zero[BLOCK];
+
+	if (b < l->nfull)
+		return l->p + b * BLOCK;
+	else if (b < l->nblk)
+		return l->tail + (b - l->nfull) * BLOCK;
+	else
+		return zero;
+}
+
+
+#define ROL(x, n) \
+	_mm_or_si128(_mm_slli_epi32((x), (n)), _mm_srli_epi32((x), 32-(n)))
+
+#define F0(b, c, d) \
+	_mm_xor_si128((d), _mm_and_si128((b), _mm_xor_si128((c), (d))))
+#define F1(b, c, d) \
+	_mm_xor_si128(_mm_xor_si128((b), (c)), (d))
+#define F2(b, c, d) \
+	_mm_or_si128(_mm_and_si128((b), (c)), \
+		     _mm_and_si128((d), _mm_or_si128((b), (c))))
+
+#define ROUND(f, k)							\
+	do {								\
+		__m128i t = _mm_add_epi32(ROL(a, 5), f(b, c, d));	\
+		t = _mm_add_epi32(t, _mm_add_epi32(e, _mm_add_epi32(	\
+				  w[i & 15], _mm_set1_epi32(k))));	\
+		e = d;							\
+		d = c;							\
+		c = ROL(b, 30);						\
+		b = a;							\
+		a = t;							\
+	} while (0)
+
+
+/* Hash one block of each lane */
+static void transform_x4(__m128i st[5], const uint8_t *blk[LANES])
+{
+	__m128i a, b, c, d, e, w[16];
+	int i;
+
+	for (i=0; i<16; i++) {
+		w[i] = _mm_set_epi32((int)rd32(blk[3] + 4*i),
+				     (int)rd32(blk[2] + 4*i),
+				     (int)rd32(blk[1] + 4*i),
+				     (int)rd32(blk[0] + 4*i));
+	}
+
+	a = st[0];
+	b = st[1];
+	c = st[2];
+	d = st[3];
+	e = st[4];
+
+	for (i=0; i<80; i++) {
+
+		if (i >= 16) {
+			w[i & 15] = ROL(_mm_xor_si128(
+				_mm_xor_si128(w[(i+13) & 15], w[(i+8) & 15]),
+				_mm_xor_si128(w[(i+2) & 15], w[i & 15])), 1);
+		}
+
+		if (i < 20)
+			ROUND(F0, 0x5a827999);
+		else if (i < 40)
+			ROUND(F1, 0x6ed9eba1);
+		else if (i < 60)
+			ROUND(F2, (int)0x8f1bbcdc);
+		else
+			ROUND(F1, (int)0xca62c1d6);
+	}
+
+	st[0] = _mm_add_epi32(st[0], a);
+	st[1] = _mm_add_epi32(st[1], b);
+	st[2] = _mm_add_epi32(st[2], c);
+	st[3] = _mm_add_epi32(st[3], d);
+	st[4] = _mm_add_epi32(st[4], e);
+}
+
+
+static void lane_final(const struct lane *l, const __m128i st[5], int n)
+{
+	uint32_t v[LANES];
+	int i;
+
+	for (i=0; i<5; i++) {
+		_mm_storeu_si128((__m128i *)(void *)v, st[i]);
+		wr32(l->md + 4*i, v[n]);
+	}
+}
+
+
+static void sha1_x4(struct lane *lv, size_t n)
+{
+	const uint8_t *blk[LANES];
+	size_t b, maxblk = 0;
+	__m128i st[5];
+	size_t i;
+
+	for (i=0; i<n; i++)
+		maxblk = max(maxblk, lv[i].nblk);
+
+	st[0] = _mm_set1_epi32(0x67452301);
+	st[1] = _mm_set1_epi32((int)0xefcdab89);
+	st[2] = _mm_set1_epi32((int)0x98badcfe);
+	st[3] = _mm_set1_epi32(0x10325476);
+	st[4] = _mm_set1_epi32((int)0xc3d2e1f0);
+
+	for (b=0; b<maxblk; b++) {
+
+		/* unused lanes repeat the first lane */
+		for (i=0; i<LANES; i++)
+			blk[i] = lane_block(&lv[i < n ? i : 0], b);
+
+		transform_x4(st, blk);
+
+		for (i=0; i<n; i++) {
+			if (b + 1 == lv[i].nblk)
+				lane_final(&lv[i], st, (int)i);
+		}
+	}
+}
+#endif
+
+
+/**
+ * Calculate the SHA-1 digests of several independent messages
+ *
+ * @param mdv   Array of digest outputs, SHA_DIGEST_LENGTH bytes each
+ * @param datav Array of messages
+ * @param lenv  Array of message lengths
+ * @param n     Number of messages
+ */
+void sha1_multi(uint8_t * const mdv[], const uint8_t * const datav[],
+		const size_t lenv[], size_t n)
+{
+	size_t i = 0;
+
+	if (!mdv || !datav || !lenv)
+		return;
+
+#ifdef SHA1_MB_SSE2
+	if (n > 1 && use_x4()) {
+
+		struct lane lv[LANES];
+
+		for (; i + 1 < n; i += LANES) {
+
+			const size_t m = min(n - i, (size_t)LANES);
+			size_t j;
+
+			for (j=0; j<m; j++)
+				lane_init(&lv[j], mdv[i+j], datav[i+j],
+					  lenv[i+j]);
+
+			sha1_x4(lv, m);
+		}
+	}
+#endif
+
+	for (; i < n; i++)
+		sha1_one(mdv[i], datav[i], lenv[i]);
+}
@@ -10,8 +10,23 @@
 #include <re_uri.h>
 #include <re_list.h>
 #include <re_sa.h>
+#include <re_udp.h>
 #include <re_msg.h>
 #include <re_sip.h>
+#include "sip.h"
+
+
+static struct re_regex rx_nameaddr =
+	RE_REGEX_INIT("[~ \t\r\n<]*[ \t\r\n]*<[^>]+>[^]*");
+static struct re_regex rx_addrspec =
+	RE_REGEX_INIT("[^;]+[^]*");
+
+
+void sip_addr_regex_compile(void)
+{
+	(void)re_regex_compile(&rx_nameaddr, rx_nameaddr.expr);
+	(void)re_regex_compile(&rx_addrspec, rx_addrspec.expr);
+}
 
 
 /**
@@ -29,10 +44,12 @@ int sip_addr_decode(struct sip_addr *addr, const struct pl *pl)
 	if (!addr || !pl)
 		return EINVAL;
 
+	sip_regex_init();
+
 	memset(addr, 0, sizeof(*addr));
 
-	if (0 == re_regex(pl->p, pl->l, "[~ \t\r\n<]*[ \t\r\n]*<[^>]+>[^]*",
-			  &addr->dname, NULL, &addr->auri, &addr->params)) {
+	if (0 == re_regex_exec(&rx_nameaddr, pl->p, pl->l,
+			       &addr->dname, NULL, &addr->auri, &addr->params)) {
 
 		if (!addr->dname.l)
 			addr->dname.p = NULL;
@@ -43,8 +60,8 @@ int sip_addr_decode(struct sip_addr *addr, const struct pl *pl)
 	else {
 		memset(addr, 0, sizeof(*addr));
 
-		if (re_regex(pl->p, pl->l, "[^;]+[^]*",
-			     &addr->auri, &addr->params))
+		if (re_regex_exec(&rx_addrspec, pl->p, pl->l,
+				  &addr->auri, &addr->params))
 			return EBADMSG;
 	}
 
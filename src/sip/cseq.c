@@ -9,8 +9,20 @@
 #include <re_uri.h>
 #include <re_list.h>
 #include <re_sa.h>
+#include <re_udp.h>
 #include <re_msg.h>
 #include <re_sip.h>
+#include "sip.h"
+
+
+static struct re_regex rx_cseq =
+	RE_REGEX_INIT("[0-9]+[ \t\r\n]+[^ \t\r\n]+");
+
+
+void sip_cseq_regex_compile(void)
+{
+	(void)re_regex_compile(&rx_cseq, rx_cseq.expr);
+}
 
 
 /**
@@ -29,8 +41,9 @@ int sip_cseq_decode(struct sip_cseq *cseq, const struct pl *pl)
 	if (!cseq || !pl)
 		return EINVAL;
 
-	err = re_regex(pl->p, pl->l, "[0-9]+[ \t\r\n]+[^ \t\r\n]+",
-		       &num, NULL, &cseq->met);
+	sip_regex_init();
+
+	err = re_regex_exec(&rx_cseq, pl->p, pl->l, &num, NULL, &cseq->met);
 	if (err)
 		return err;
 
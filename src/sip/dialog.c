@@ -73,23 +73,10 @@ static void destructor(void *arg)
 }
 
 
-/**
- * Allocate a SIP Dialog
- *
- * @param dlgp      Pointer to allocated SIP Dialog
- * @param uri       Target URI
- * @param to_uri    To URI
- * @param from_name From displayname (optional)
- * @param from_uri  From URI
- * @param routev    Route vector
- * @param routec    Route count
- *
- * @return 0 if success, otherwise errorcode
- */
-int sip_dialog_alloc(struct sip_dialog **dlgp,
-		     const char *uri, const char *to_uri,
-		     const char *from_name, const char *from_uri,
-		     const char *routev[], uint32_t routec)
+static int dialog_alloc(struct sip_dialog **dlgp, const struct sip *sip,
+			const char *uri, const char *to_uri,
+			const char *from_name, const char *from_uri,
+			const char *routev[], uint32_t routec)
 {
 	const uint64_t ltag = rand_u64();
 	struct sip_dialog *dlg;
@@ -117,6 +104,13 @@ int sip_dialog_alloc(struct sip_dialog **dlgp,
 	if (err)
 		goto out;
 
+	/* the requests of the dialog are received by the owning shard */
+	pl_set_str(&pl, dlg->callid);
+	while (sip && !sip_shard_owns(sip, &pl)) {
+		(void)re_snprintf(dlg->callid, X64_STRSIZE, "%016llx",
+				  rand_u64());
+	}
+
 	err = x64_strdup(&dlg->ltag, ltag);
 	if (err)
 		goto out;
@@ -138,6 +132,7 @@ int sip_dialog_alloc(struct sip_dialog **dlgp,
 			   from_name ? "\"" : "", from_name,
 			   from_name ? "\" " : "",
 			   from_uri, ltag);
+	err |= mbuf_printf(dlg->mb, "Call-ID: %s\r\n", dlg->callid);
 	if (err)
 		goto out;
 
@@ -164,6 +159,57 @@ int sip_dialog_alloc(struct sip_dialog **dlgp,
 }
 
 
+/**
+ * Allocate a SIP Dialog
+ *
+ * @param dlgp      Pointer to allocated SIP Dialog
+ * @param uri       Target URI
+ * @param to_uri    To URI
+ * @param from_name From displayname (optional)
+ * @param from_uri  From URI
+ * @param routev    Route vector
+ * @param routec    Route count
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_dialog_alloc(struct sip_dialog **dlgp,
+		     const char *uri, const char *to_uri,
+		     const char *from_name, const char *from_uri,
+		     const char *routev[], uint32_t routec)
+{
+	return dialog_alloc(dlgp, NULL, uri, to_uri, from_name, from_uri,
+			    routev, routec);
+}
+
+
+/**
+ * Allocate a SIP Dialog with a Call-ID owned by the shard of a SIP stack,
+ * so that the in-dialog requests are received by that stack
+ *
+ * @param dlgp      Pointer to allocated SIP Dialog
+ * @param sip       SIP stack instance
+ * @param uri       Target URI
+ * @param to_uri    To URI
+ * @param from_name From displayname (optional)
+ * @param from_uri  From URI
+ * @param routev    Route vector
+ * @param routec    Route count
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_dialog_alloc_shard(struct sip_dialog **dlgp, const struct sip *sip,
+			   const char *uri, const char *to_uri,
+			   const char *from_name, const char *from_uri,
+			   const char *routev[], uint32_t routec)
+{
+	if (!sip)
+		return EINVAL;
+
+	return dialog_alloc(dlgp, sip, uri, to_uri, from_name, from_uri,
+			    routev, routec);
+}
+
+
 static bool record_route_handler(const struct sip_hdr *hdr,
 				 const struct sip_msg *msg,
 				 void *arg)
@@ -247,6 +293,7 @@ int sip_dialog_accept(struct sip_dialog **dlgp, const struct sip_msg *msg)
 	err |= mbuf_printf(dlg->mb, "To: %r\r\n", &msg->from.val);
 	err |= mbuf_printf(dlg->mb, "From: %r;tag=%016llx\r\n", &msg->to.val,
 			   msg->tag);
+	err |= mbuf_printf(dlg->mb, "Call-ID: %s\r\n", dlg->callid);
 	if (err)
 		goto out;
 
@@ -535,18 +582,42 @@ bool sip_dialog_rseq_valid(struct sip_dialog *dlg, const struct sip_msg *msg)
 }
 
 
+static int cseq_encode(struct mbuf *mb, uint32_t num, const char *met)
+{
+	char buf[10];
+	size_t i = sizeof(buf);
+	int err;
+
+	do {
+		buf[--i] = '0' + num % 10;
+		num /= 10;
+	} while (num);
+
+	err  = mbuf_write_mem(mb, (const uint8_t *)"CSeq: ", 6);
+	err |= mbuf_write_mem(mb, (const uint8_t *)&buf[i], sizeof(buf) - i);
+	err |= mbuf_write_u8(mb, ' ');
+	err |= mbuf_write_str(mb, met);
+	err |= mbuf_write_mem(mb, (const uint8_t *)"\r\n", 2);
+
+	return err;
+}
+
+
+/*
+ * The Route set, To, From and Call-ID headers do not change once the
+ * dialog is established, they are kept encoded in dlg->mb. A target
+ * refresh only changes the Request-URI.
+ */
 int sip_dialog_encode(struct mbuf *mb, struct sip_dialog *dlg, uint32_t cseq,
 		      const char *met)
 {
-	int err = 0;
+	int err;
 
 	if (!mb || !dlg || !met)
 		return EINVAL;
 
-	err |= mbuf_write_mem(mb, mbuf_buf(dlg->mb), mbuf_get_left(dlg->mb));
-	err |= mbuf_printf(mb, "Call-ID: %s\r\n", dlg->callid);
-	err |= mbuf_printf(mb, "CSeq: %u %s\r\n", strcmp(met, "ACK") ?
-			   dlg->lseq++ : cseq, met);
+	err  = mbuf_write_mem(mb, mbuf_buf(dlg->mb), mbuf_get_left(dlg->mb));
+	err |= cseq_encode(mb, strcmp(met, "ACK") ? dlg->lseq++ : cseq, met);
 
 	return err;
 }
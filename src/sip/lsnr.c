@@ -0,0 +1,394 @@
+/**
+ * @file lsnr.c  SIP Listeners
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_sa.h>
+#include <re_list.h>
+#include <re_hash.h>
+#include <re_fmt.h>
+#include <re_uri.h>
+#include <re_udp.h>
+#include <re_msg.h>
+#include <re_sip.h>
+#include "sip.h"
+
+
+/*
+ * Listeners are indexed by request/response and method. A listener
+ * registered for a method sits in a hashtable bucket, a listener for
+ * all methods sits on a list. Incoming messages are offered to the
+ * matching listeners of both in registration order.
+ *
+ * The optional dialog cache remembers which method listener claimed an
+ * in-dialog request, keyed by Call-ID, tags and method. The next request
+ * of that dialog and method skips the method listeners registered before
+ * its owner, while the listeners for all methods (e.g. the transaction
+ * layer) are still consulted first.
+ */
+
+
+enum {
+	LSNR_HASH_SIZE = 16,
+	DLGC_LOAD = 4,
+};
+
+
+/** Dialog cache entry */
+struct dlgc {
+	struct le he;            /**< Hash element in dialog cache     */
+	struct le le;            /**< Linked list element in listener  */
+	struct sip_lsnr *lsnr;   /**< Owning listener                  */
+	struct pl callid;        /**< Call-ID                          */
+	struct pl ltag;          /**< Local tag (To)                   */
+	struct pl rtag;          /**< Remote tag (From)                */
+	struct pl met;           /**< Request method                   */
+};
+
+
+static void dlgc_destructor(void *arg)
+{
+	struct dlgc *dc = arg;
+	struct sip *sip = dc->lsnr->sip;
+
+	if (sip->dlgc_cur == dc)
+		sip->dlgc_cur = NULL;
+
+	hash_unlink(&dc->he);
+	list_unlink(&dc->le);
+	--sip->dlgc_cnt;
+}
+
+
+static void lsnr_destructor(void *arg)
+{
+	struct sip_lsnr *lsnr = arg;
+
+	if (lsnr->sip->lsnr_cur == lsnr)
+		lsnr->sip->lsnr_cur = NULL;
+
+	if (lsnr->lsnrp)
+		*lsnr->lsnrp = NULL;
+
+	list_flush(&lsnr->dlgcl);
+	list_unlink(&lsnr->le);
+	list_unlink(&lsnr->ile);
+	mem_deref(lsnr->met);
+}
+
+
+static bool dlgc_cmp_handler(struct le *le, void *arg)
+{
+	const struct dlgc *dc = le->data;
+	const struct sip_msg *msg = arg;
+
+	return !pl_cmp(&dc->callid, &msg->callid) &&
+		!pl_cmp(&dc->ltag, &msg->to.tag) &&
+		!pl_cmp(&dc->rtag, &msg->from.tag) &&
+		!pl_cmp(&dc->met, &msg->met);
+}
+
+
+static struct dlgc *dlgc_lookup(const struct sip *sip,
+				const struct sip_msg *msg)
+{
+	return list_ledata(hash_lookup(sip->ht_dlgc,
+				       hash_joaat_pl(&msg->callid),
+				       dlgc_cmp_handler, (void *)msg));
+}
+
+
+static void pl_set(struct pl *pl, char **p, const struct pl *src)
+{
+	memcpy(*p, src->p, src->l);
+
+	pl->p = *p;
+	pl->l = src->l;
+
+	*p += src->l;
+}
+
+
+static void dlgc_add(struct sip_lsnr *lsnr, const struct sip_msg *msg)
+{
+	struct sip *sip = lsnr->sip;
+	struct dlgc *dc;
+	char *p;
+
+	if (sip->dlgc_cnt >= sip->dlgc_max)
+		hash_flush(sip->ht_dlgc);
+
+	dc = mem_zalloc(sizeof(*dc) + msg->callid.l + msg->to.tag.l +
+			msg->from.tag.l + msg->met.l, dlgc_destructor);
+	if (!dc)
+		return;
+
+	p = (char *)(dc + 1);
+
+	pl_set(&dc->callid, &p, &msg->callid);
+	pl_set(&dc->ltag, &p, &msg->to.tag);
+	pl_set(&dc->rtag, &p, &msg->from.tag);
+	pl_set(&dc->met, &p, &msg->met);
+
+	dc->lsnr = lsnr;
+	++sip->dlgc_cnt;
+
+	hash_append(sip->ht_dlgc, hash_joaat_pl(&msg->callid), &dc->he, dc);
+	list_append(&lsnr->dlgcl, &dc->le, dc);
+}
+
+
+/* Next listener in registration order from the method bucket and the
+   list of listeners for all methods */
+static struct sip_lsnr *lsnr_next(struct le **lw, struct le **lm, bool req,
+				  const struct pl *met)
+{
+	struct sip_lsnr *w, *m = NULL;
+
+	for (; *lm; *lm = (*lm)->next) {
+
+		m = (*lm)->data;
+
+		if (m->req == req && !pl_strcmp(met, m->met))
+			break;
+
+		m = NULL;
+	}
+
+	w = *lw ? (*lw)->data : NULL;
+
+	if (w && (!m || w->seq < m->seq)) {
+		*lw = (*lw)->next;
+		return w;
+	}
+
+	if (m)
+		*lm = (*lm)->next;
+
+	return m;
+}
+
+
+static int lsnr_alloc(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
+		      const char *met, sip_msg_h *msgh, void *arg)
+{
+	struct sip_lsnr *lsnr;
+	int err;
+
+	if (!sip || !msgh)
+		return EINVAL;
+
+	lsnr = mem_zalloc(sizeof(*lsnr), lsnr_destructor);
+	if (!lsnr)
+		return ENOMEM;
+
+	lsnr->sip = sip;
+
+	if (met) {
+		err = str_dup(&lsnr->met, met);
+		if (err) {
+			mem_deref(lsnr);
+			return err;
+		}
+
+		hash_append(sip->ht_lsnr, hash_joaat_str(met),
+			    &lsnr->ile, lsnr);
+	}
+	else {
+		list_append(req ? &sip->lsnrl_req : &sip->lsnrl_resp,
+			    &lsnr->ile, lsnr);
+	}
+
+	list_append(&sip->lsnrl, &lsnr->le, lsnr);
+
+	lsnr->msgh = msgh;
+	lsnr->arg = arg;
+	lsnr->req = req;
+	lsnr->seq = sip->lsnr_seq++;
+
+	if (lsnrp) {
+		lsnr->lsnrp = lsnrp;
+		*lsnrp = lsnr;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Listen for incoming SIP Requests and SIP Responses
+ *
+ * @param lsnrp Pointer to allocated listener
+ * @param sip   SIP stack instance
+ * @param req   True for Request, false for Response
+ * @param msgh  SIP message handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_listen(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
+	       sip_msg_h *msgh, void *arg)
+{
+	return lsnr_alloc(lsnrp, sip, req, NULL, msgh, arg);
+}
+
+
+/**
+ * Listen for incoming SIP Requests or SIP Responses of one method
+ *
+ * @param lsnrp Pointer to allocated listener
+ * @param sip   SIP stack instance
+ * @param req   True for Request, false for Response
+ * @param met   Request method, or CSeq method of responses
+ * @param msgh  SIP message handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_listen_method(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
+		      const char *met, sip_msg_h *msgh, void *arg)
+{
+	if (!met)
+		return EINVAL;
+
+	return lsnr_alloc(lsnrp, sip, req, met, msgh, arg);
+}
+
+
+/**
+ * Enable or disable the dialog cache of the SIP listeners
+ *
+ * @param sip    SIP stack instance
+ * @param htsize Hashtable size (power of 2), or 0 to disable
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_set_dialog_cache(struct sip *sip, uint32_t htsize)
+{
+	if (!sip)
+		return EINVAL;
+
+	hash_flush(sip->ht_dlgc);
+	sip->ht_dlgc = mem_deref(sip->ht_dlgc);
+	sip->dlgc_max = 0;
+
+	if (!htsize)
+		return 0;
+
+	sip->dlgc_max = htsize * DLGC_LOAD;
+
+	return hash_alloc(&sip->ht_dlgc, htsize);
+}
+
+
+int sip_lsnr_init(struct sip *sip)
+{
+	return hash_alloc(&sip->ht_lsnr, LSNR_HASH_SIZE);
+}
+
+
+void sip_lsnr_close(struct sip *sip)
+{
+	list_flush(&sip->lsnrl);
+	hash_flush(sip->ht_dlgc);
+	sip->ht_dlgc = mem_deref(sip->ht_dlgc);
+	sip->ht_lsnr = mem_deref(sip->ht_lsnr);
+}
+
+
+/**
+ * Offer an incoming SIP message to the listeners
+ *
+ * @param sip SIP stack instance
+ * @param msg SIP message
+ *
+ * @return True if claimed by a listener, otherwise false
+ */
+bool sip_lsnr_recv(struct sip *sip, const struct sip_msg *msg)
+{
+	const struct pl *met = msg->req ? &msg->met : &msg->cseq.met;
+	struct sip_lsnr *lsnr;
+	struct le *lw, *lm;
+	bool claimed = false;
+	bool dlg;
+
+	lw = list_head(msg->req ? &sip->lsnrl_req : &sip->lsnrl_resp);
+	lm = list_head(hash_list(sip->ht_lsnr, hash_joaat_pl(met)));
+
+	/* the cache entry is cleared by its destructor */
+	dlg = msg->req && sip->ht_dlgc && pl_isset(&msg->to.tag);
+	if (dlg)
+		sip->dlgc_cur = dlgc_lookup(sip, msg);
+
+	/* the handlers may close the listeners or the stack */
+	mem_ref(sip);
+
+	while ((lsnr = lsnr_next(&lw, &lm, msg->req, met))) {
+
+		const struct dlgc *dc = sip->dlgc_cur;
+		bool owner = dc && dc->lsnr == lsnr;
+
+		if (dc && !owner && lsnr->met && lsnr->seq < dc->lsnr->seq)
+			continue;
+
+		sip->lsnr_cur = lsnr;
+
+		claimed = lsnr->msgh(msg, lsnr->arg);
+
+		/* cleared by the destructor */
+		if (sip->lsnr_cur != lsnr) {
+			if (claimed)
+				break;
+			continue;
+		}
+
+		if (owner) {
+			if (claimed)
+				++lsnr->cache_hits;
+			else
+				mem_deref(sip->dlgc_cur);
+
+			sip->dlgc_cur = NULL;
+		}
+		else if (claimed && dlg && lsnr->met) {
+			dlgc_add(lsnr, msg);
+		}
+
+		if (claimed) {
+			++lsnr->hits;
+			break;
+		}
+	}
+
+	sip->lsnr_cur = NULL;
+	sip->dlgc_cur = NULL;
+	mem_deref(sip);
+
+	return claimed;
+}
+
+
+int sip_lsnr_debug(struct re_printf *pf, const struct sip *sip)
+{
+	struct le *le;
+	int err;
+
+	err = re_hprintf(pf, "listeners: (dialog cache %u/%u)\n",
+			 sip->dlgc_cnt, sip->dlgc_max);
+
+	for (le = sip->lsnrl.head; le; le = le->next) {
+
+		const struct sip_lsnr *lsnr = le->data;
+
+		err |= re_hprintf(pf, "  %-8s %-10s hits=%u cached=%u\n",
+				  lsnr->req ? "request" : "response",
+				  lsnr->met ? lsnr->met : "*",
+				  lsnr->hits, lsnr->cache_hits);
+	}
+
+	return err;
+}
@@ -12,9 +12,12 @@ SRCS	+= sip/ctrans.c
 SRCS	+= sip/dialog.c
 SRCS	+= sip/keepalive.c
 SRCS	+= sip/keepalive_udp.c
+SRCS	+= sip/lsnr.c
 SRCS	+= sip/msg.c
+SRCS	+= sip/overload.c
 SRCS	+= sip/reply.c
 SRCS	+= sip/request.c
+SRCS	+= sip/shard.c
 SRCS	+= sip/sip.c
 SRCS	+= sip/strans.c
 SRCS	+= sip/transp.c
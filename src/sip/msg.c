@@ -4,6 +4,9 @@
  * Copyright (C) 2010 Creytiv.com
  */
 #include <ctype.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include <re_types.h>
 #include <re_mem.h>
 #include <re_sys.h>
@@ -249,6 +252,41 @@ static inline int hdr_add(struct sip_msg *msg, const struct pl *name,
 }
 
 
+static struct re_regex rx_startline =
+	RE_REGEX_INIT("[^ \t\r\n]+ [^ \t\r\n]+ [^\r\n]*[\r]*[\n]1");
+
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t rx_once = PTHREAD_ONCE_INIT;
+#else
+static bool rx_done;
+#endif
+
+
+static void regex_compile(void)
+{
+	(void)re_regex_compile(&rx_startline, rx_startline.expr);
+
+	sip_addr_regex_compile();
+	sip_cseq_regex_compile();
+	sip_via_regex_compile();
+}
+
+
+/* The patterns are shared by all threads and compiled on first use */
+void sip_regex_init(void)
+{
+#ifdef HAVE_PTHREAD
+	(void)pthread_once(&rx_once, regex_compile);
+#else
+	if (!rx_done) {
+		regex_compile();
+		rx_done = true;
+	}
+#endif
+}
+
+
 /**
  * Decode a SIP message
  *
@@ -271,11 +309,13 @@ int sip_msg_decode(struct sip_msg **msgp, struct mbuf *mb)
 	if (!msgp || !mb)
 		return EINVAL;
 
+	sip_regex_init();
+
 	p = (const char *)mbuf_buf(mb);
 	l = mbuf_get_left(mb);
 
-	if (re_regex(p, l, "[^ \t\r\n]+ [^ \t\r\n]+ [^\r\n]*[\r]*[\n]1",
-		     &x, &y, &z, NULL, &e) || x.p != (char *)mbuf_buf(mb))
+	if (re_regex_exec(&rx_startline, p, l, &x, &y, &z, NULL, &e) ||
+	    x.p != (char *)mbuf_buf(mb))
 		return (l > STARTLINE_MAX) ? EBADMSG : ENODATA;
 
 	msg = mem_zalloc(sizeof(*msg), destructor);
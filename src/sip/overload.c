@@ -0,0 +1,208 @@
+/**
+ * @file overload.c  SIP Overload Control
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <re_types.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_sa.h>
+#include <re_list.h>
+#include <re_hash.h>
+#include <re_fmt.h>
+#include <re_uri.h>
+#include <re_tmr.h>
+#include <re_udp.h>
+#include <re_msg.h>
+#include <re_sip.h>
+#include "sip.h"
+
+
+/*
+ * The stack is overloaded when the reactor lags behind its timers, or
+ * when there are too many server transactions. New requests outside a
+ * dialog are then rejected with 503 before reaching the listeners.
+ * Responses, ACK, CANCEL, in-dialog requests and retransmissions of
+ * requests with a server transaction are always let through, they
+ * complete work that has already been accepted.
+ */
+
+
+enum {
+	OC_INTERVAL = 100,
+};
+
+
+/** Overload control state */
+struct sip_overload {
+	struct tmr tmr;          /**< Reactor lag timer                */
+	uint64_t due;            /**< Expected timer expiry            */
+	uint32_t lag;            /**< Last measured lag in [ms]        */
+	uint32_t lag_max;        /**< Maximum reactor lag in [ms]      */
+	uint32_t strans_max;     /**< Maximum server transactions      */
+	uint32_t retry_after;    /**< Retry-After value in [s]         */
+	uint32_t shed;           /**< Number of rejected requests      */
+	uint32_t passed;         /**< Priority messages let through    */
+};
+
+
+static void destructor(void *arg)
+{
+	struct sip_overload *oc = arg;
+
+	tmr_cancel(&oc->tmr);
+}
+
+
+static void tmr_handler(void *arg)
+{
+	struct sip_overload *oc = arg;
+	const uint64_t now = tmr_jiffies();
+
+	oc->lag = (uint32_t)(now > oc->due ? now - oc->due : 0);
+	oc->due = now + OC_INTERVAL;
+
+	tmr_start(&oc->tmr, OC_INTERVAL, tmr_handler, oc);
+}
+
+
+/* The timer is late while the reactor is busy with a burst */
+static uint32_t lag_get(const struct sip_overload *oc)
+{
+	const uint64_t now = tmr_jiffies();
+
+	if (!tmr_isrunning(&oc->tmr))
+		return 0;
+
+	if (now > oc->due)
+		return max(oc->lag, (uint32_t)(now - oc->due));
+
+	return oc->lag;
+}
+
+
+static bool overloaded(const struct sip *sip)
+{
+	const struct sip_overload *oc = sip->oc;
+
+	if (oc->lag_max && lag_get(oc) > oc->lag_max)
+		return true;
+
+	if (oc->strans_max && sip->stransc >= oc->strans_max)
+		return true;
+
+	return false;
+}
+
+
+static bool is_priority(const struct sip *sip, const struct sip_msg *msg)
+{
+	if (!msg->req)
+		return true;
+
+	if (pl_isset(&msg->to.tag))
+		return true;
+
+	if (!pl_strcmp(&msg->met, "ACK") || !pl_strcmp(&msg->met, "CANCEL"))
+		return true;
+
+	/* a retransmission is answered by its transaction */
+	return sip_strans_exists(sip, msg);
+}
+
+
+/**
+ * Set the overload control thresholds of a SIP stack
+ *
+ * @param sip         SIP stack instance
+ * @param lag_max     Maximum reactor lag in [ms], 0 to ignore
+ * @param strans_max  Maximum number of server transactions, 0 to ignore
+ * @param retry_after Retry-After value of rejected requests in [s]
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note Overload control is disabled if both thresholds are 0
+ */
+int sip_set_overload(struct sip *sip, uint32_t lag_max, uint32_t strans_max,
+		     uint32_t retry_after)
+{
+	struct sip_overload *oc;
+
+	if (!sip)
+		return EINVAL;
+
+	if (!lag_max && !strans_max) {
+		sip->oc = mem_deref(sip->oc);
+		return 0;
+	}
+
+	if (!sip->oc) {
+		sip->oc = mem_zalloc(sizeof(*sip->oc), destructor);
+		if (!sip->oc)
+			return ENOMEM;
+	}
+
+	oc = sip->oc;
+
+	oc->lag_max     = lag_max;
+	oc->strans_max  = strans_max;
+	oc->retry_after = retry_after;
+
+	if (!lag_max) {
+		tmr_cancel(&oc->tmr);
+		oc->lag = 0;
+	}
+	else if (!tmr_isrunning(&oc->tmr)) {
+		oc->due = tmr_jiffies();
+		tmr_handler(oc);
+	}
+
+	return 0;
+}
+
+
+/**
+ * Reject an incoming SIP message if the stack is overloaded
+ *
+ * @param sip SIP stack instance
+ * @param msg Incoming SIP message
+ *
+ * @return True if the message was rejected, otherwise false
+ */
+bool sip_overload_shed(struct sip *sip, const struct sip_msg *msg)
+{
+	struct sip_overload *oc = sip->oc;
+
+	if (!oc || !overloaded(sip))
+		return false;
+
+	if (is_priority(sip, msg)) {
+		++oc->passed;
+		return false;
+	}
+
+	++oc->shed;
+
+	(void)sip_replyf(sip, msg, 503, "Service Unavailable",
+			 "Retry-After: %u\r\n"
+			 "Content-Length: 0\r\n"
+			 "\r\n",
+			 oc->retry_after);
+
+	return true;
+}
+
+
+int sip_overload_debug(struct re_printf *pf, const struct sip *sip)
+{
+	const struct sip_overload *oc = sip->oc;
+
+	if (!oc)
+		return 0;
+
+	return re_hprintf(pf, "overload control: lag=%ums/%ums"
+			  " strans=%u/%u (shed=%u passed=%u)\n",
+			  lag_get(oc), oc->lag_max,
+			  sip->stransc, oc->strans_max,
+			  oc->shed, oc->passed);
+}
@@ -3,6 +3,7 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#include <string.h>
 #include <re_types.h>
 #include <re_mem.h>
 #include <re_mbuf.h>
@@ -16,104 +17,242 @@
 #include "sip.h"
 
 
-static int vreplyf(struct sip_strans **stp, struct mbuf **mbp, bool trans,
-		   struct sip *sip, const struct sip_msg *msg, bool rec_route,
-		   uint16_t scode, const char *reason,
-		   const char *fmt, va_list ap)
+enum {
+	TAG_LEN = 16,
+	FMT_SLACK = 256,
+};
+
+
+/* Via, To and tag values added to the copied request headers */
+struct rinfo {
+	struct pl rp;
+	char port[6];
+	char addr[64];
+	char tag[TAG_LEN];
+	size_t portl;
+	size_t addrl;
+	bool rport;
+	bool received;
+	bool totag;
+};
+
+
+static size_t u16_print(char *buf, uint16_t v)
 {
-	bool rport = false;
-	uint32_t viac = 0;
-	struct mbuf *mb;
-	struct sa dst;
+	char tmp[5];
+	size_t n = 0, i;
+
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	for (i=0; i<n; i++)
+		buf[i] = tmp[n - 1 - i];
+
+	return n;
+}
+
+
+static void hex64_print(char *buf, uint64_t v)
+{
+	static const char hex[] = "0123456789abcdef";
+	int i;
+
+	for (i=TAG_LEN-1; i>=0; i--) {
+		buf[i] = hex[v & 0xf];
+		v >>= 4;
+	}
+}
+
+
+static void rinfo_init(struct rinfo *ri, const struct sip_msg *msg,
+		       uint16_t scode)
+{
+	memset(ri, 0, sizeof(*ri));
+
+	if (!msg_param_exists(&msg->via.params, "rport", &ri->rp)) {
+		ri->rport = true;
+		ri->portl = u16_print(ri->port, sa_port(&msg->src));
+	}
+
+	if (ri->rport || !sa_cmp(&msg->src, &msg->via.addr, SA_ADDR)) {
+		ri->received = !sa_ntop(&msg->src, ri->addr,
+					sizeof(ri->addr));
+		ri->addrl = ri->received ? strlen(ri->addr) : 0;
+	}
+
+	if (!pl_isset(&msg->to.tag) && scode > 100) {
+		ri->totag = true;
+		hex64_print(ri->tag, msg->tag);
+	}
+}
+
+
+static inline bool hdr_copied(const struct sip_hdr *hdr, bool rec_route)
+{
+	switch (hdr->id) {
+
+	case SIP_HDR_RECORD_ROUTE:
+		return rec_route;
+
+	case SIP_HDR_VIA:
+	case SIP_HDR_TO:
+	case SIP_HDR_FROM:
+	case SIP_HDR_CALL_ID:
+	case SIP_HDR_CSEQ:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+
+/* Exact size of the status line and the copied headers */
+static size_t reply_size(const struct sip_msg *msg, const struct rinfo *ri,
+			 bool rec_route, const char *reason)
+{
+	size_t sz = sizeof("SIP/2.0 000 ") - 1 + strlen(reason) + 2;
+	bool first_via = true;
 	struct le *le;
-	int err;
 
-	if (!sip || !msg || !reason)
-		return EINVAL;
+	for (le = msg->hdrl.head; le; le = le->next) {
 
-	if (!pl_strcmp(&msg->met, "ACK"))
-		return 0;
+		const struct sip_hdr *hdr = le->data;
 
-	mb = mbuf_alloc(1024);
-	if (!mb) {
-		err = ENOMEM;
-		goto out;
+		if (!hdr_copied(hdr, rec_route))
+			continue;
+
+		sz += hdr->name.l + 2 + hdr->val.l + 2;
+
+		if (hdr->id == SIP_HDR_VIA && first_via) {
+			first_via = false;
+			if (ri->rport)
+				sz += sizeof(";rport=") - 1 + ri->portl -
+					ri->rp.l;
+			if (ri->received)
+				sz += sizeof(";received=") - 1 + ri->addrl;
+		}
+		else if (hdr->id == SIP_HDR_TO && ri->totag) {
+			sz += sizeof(";tag=") - 1 + TAG_LEN;
+		}
 	}
 
-	err = mbuf_printf(mb, "SIP/2.0 %u %s\r\n", scode, reason);
+	return sz;
+}
+
+
+static int reply_encode(struct mbuf *mb, const struct sip_msg *msg,
+			const struct rinfo *ri, bool rec_route,
+			uint16_t scode, const char *reason)
+{
+	bool first_via = true;
+	char code[5];
+	struct le *le;
+	int err;
+
+	err  = mbuf_write_mem(mb, (uint8_t *)"SIP/2.0 ", 8);
+	err |= mbuf_write_mem(mb, (uint8_t *)code, u16_print(code, scode));
+	err |= mbuf_write_u8(mb, ' ');
+	err |= mbuf_write_str(mb, reason);
+	err |= mbuf_write_mem(mb, (uint8_t *)"\r\n", 2);
 
 	for (le = msg->hdrl.head; le; le = le->next) {
 
-		struct sip_hdr *hdr = le->data;
-		struct pl rp;
+		const struct sip_hdr *hdr = le->data;
 
-		switch (hdr->id) {
+		if (!hdr_copied(hdr, rec_route))
+			continue;
 
-		case SIP_HDR_VIA:
-			err |= mbuf_printf(mb, "%r: ", &hdr->name);
-			if (viac++) {
-				err |= mbuf_printf(mb, "%r\r\n", &hdr->val);
-				break;
-			}
+		err |= mbuf_write_pl(mb, &hdr->name);
+		err |= mbuf_write_mem(mb, (uint8_t *)": ", 2);
+
+		if (hdr->id == SIP_HDR_VIA && first_via) {
 
-			if (!msg_param_exists(&msg->via.params, "rport", &rp)){
-				err |= mbuf_write_pl_skip(mb, &hdr->val, &rp);
-				err |= mbuf_printf(mb, ";rport=%u",
-						   sa_port(&msg->src));
-				rport = true;
+			first_via = false;
+
+			if (ri->rport) {
+				err |= mbuf_write_pl_skip(mb, &hdr->val,
+							  &ri->rp);
+				err |= mbuf_write_str(mb, ";rport=");
+				err |= mbuf_write_mem(mb,
+						      (uint8_t *)ri->port,
+						      ri->portl);
 			}
-			else
+			else {
 				err |= mbuf_write_pl(mb, &hdr->val);
+			}
 
-			if (rport || !sa_cmp(&msg->src, &msg->via.addr,
-					     SA_ADDR))
-				err |= mbuf_printf(mb, ";received=%j",
-						   &msg->src);
+			if (ri->received) {
+				err |= mbuf_write_str(mb, ";received=");
+				err |= mbuf_write_mem(mb,
+						      (uint8_t *)ri->addr,
+						      ri->addrl);
+			}
+		}
+		else {
+			err |= mbuf_write_pl(mb, &hdr->val);
+
+			if (hdr->id == SIP_HDR_TO && ri->totag) {
+				err |= mbuf_write_str(mb, ";tag=");
+				err |= mbuf_write_mem(mb,
+						      (uint8_t *)ri->tag,
+						      TAG_LEN);
+			}
+		}
 
-			err |= mbuf_write_str(mb, "\r\n");
-			break;
+		err |= mbuf_write_mem(mb, (uint8_t *)"\r\n", 2);
+	}
 
-		case SIP_HDR_TO:
-			err |= mbuf_printf(mb, "%r: %r", &hdr->name,
-					   &hdr->val);
-			if (!pl_isset(&msg->to.tag) && scode > 100)
-				err |= mbuf_printf(mb, ";tag=%016llx",
-						   msg->tag);
-			err |= mbuf_write_str(mb, "\r\n");
-			break;
+	return err;
+}
+
+
+static int vreplyf(struct sip_strans **stp, struct mbuf **mbp, bool trans,
+		   struct sip *sip, const struct sip_msg *msg, bool rec_route,
+		   uint16_t scode, const char *reason,
+		   const char *fmt, va_list ap)
+{
+	static const char clen0[] = "Content-Length: 0\r\n\r\n";
+	struct mbuf *mb;
+	struct rinfo ri;
+	struct sa dst;
+	size_t sz;
+	int err;
+
+	if (!sip || !msg || !reason)
+		return EINVAL;
 
-		case SIP_HDR_RECORD_ROUTE:
-			if (!rec_route)
-				break;
+	if (!pl_strcmp(&msg->met, "ACK"))
+		return 0;
 
-			/*@fallthrough@*/
+	rinfo_init(&ri, msg, scode);
 
-		case SIP_HDR_FROM:
-		case SIP_HDR_CALL_ID:
-		case SIP_HDR_CSEQ:
-			err |= mbuf_printf(mb, "%r: %r\r\n",
-					   &hdr->name, &hdr->val);
-			break;
+	sz  = reply_size(msg, &ri, rec_route, reason);
+	sz += sip->rtmpl_len;
+	sz += fmt ? FMT_SLACK : sizeof(clen0) - 1;
 
-		default:
-			break;
-		}
+	mb = mbuf_alloc(sz);
+	if (!mb) {
+		err = ENOMEM;
+		goto out;
 	}
 
-	if (sip->software)
-		err |= mbuf_printf(mb, "Server: %s\r\n", sip->software);
+	err  = reply_encode(mb, msg, &ri, rec_route, scode, reason);
+	err |= mbuf_write_mem(mb, (uint8_t *)sip->rtmpl, sip->rtmpl_len);
 
 	if (fmt)
 		err |= mbuf_vprintf(mb, fmt, ap);
 	else
-		err |= mbuf_printf(mb, "Content-Length: 0\r\n\r\n");
+		err |= mbuf_write_mem(mb, (uint8_t *)clen0, sizeof(clen0) - 1);
 
 	if (err)
 		goto out;
 
 	mb->pos = 0;
 
-	sip_reply_addr(&dst, msg, rport);
+	sip_reply_addr(&dst, msg, ri.rport);
 
 	if (trans) {
 		err = sip_strans_reply(stp, sip, msg, &dst, scode, mb);
@@ -135,6 +274,67 @@ static int vreplyf(struct sip_strans **stp, struct mbuf **mbp, bool trans,
 }
 
 
+static int tmpl_build(struct sip *sip, const char *hdrs)
+{
+	char *tmpl = NULL;
+	int err;
+
+	err = re_sdprintf(&tmpl, "%s%s%s%s",
+			  sip->software ? "Server: " : "",
+			  sip->software ? sip->software : "",
+			  sip->software ? "\r\n" : "",
+			  hdrs ? hdrs : "");
+	if (err)
+		return err;
+
+	mem_deref(sip->rtmpl);
+	sip->rtmpl = tmpl;
+	sip->rtmpl_len = strlen(tmpl);
+
+	return 0;
+}
+
+
+int sip_reply_init(struct sip *sip)
+{
+	return tmpl_build(sip, NULL);
+}
+
+
+/**
+ * Set extra SIP headers for inclusion in all replies, like Allow and
+ * Supported. The headers are encoded once and copied into each reply,
+ * after the Server header.
+ *
+ * @param sip  SIP Stack instance
+ * @param hdrs Formatted strings with extra SIP Headers, or NULL to clear
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_set_reply_headers(struct sip *sip, const char *hdrs, ...)
+{
+	char *buf = NULL;
+	va_list ap;
+	int err;
+
+	if (!sip)
+		return EINVAL;
+
+	if (hdrs) {
+		va_start(ap, hdrs);
+		err = re_vsdprintf(&buf, hdrs, ap);
+		va_end(ap);
+		if (err)
+			return err;
+	}
+
+	err = tmpl_build(sip, buf);
+	mem_deref(buf);
+
+	return err;
+}
+
+
 /**
  * Formatted reply using Server Transaction
  *
@@ -174,7 +174,8 @@ static int request(struct sip_request *req, enum sip_transp tp,
 	if (!branch || !mb)
 		goto out;
 
-	(void)re_snprintf(branch, 24, "z9hG4bK%016llx", rand_u64());
+	(void)re_snprintf(branch, 24, "z9hG4bK%016llx",
+			  sip_shard_branch(req->sip, rand_u64()));
 
 	err = sip_transp_laddr(req->sip, &laddr, tp, dst);
 	if (err)
@@ -819,8 +820,11 @@ int sip_drequestf(struct sip_request **reqp, struct sip *sip, bool stateful,
 
 	err |= sip_dialog_encode(mb, dlg, cseq, met);
 
-	if (sip->software)
-		err |= mbuf_printf(mb, "User-Agent: %s\r\n", sip->software);
+	if (sip->software) {
+		err |= mbuf_write_str(mb, "User-Agent: ");
+		err |= mbuf_write_str(mb, sip->software);
+		err |= mbuf_write_str(mb, "\r\n");
+	}
 
 	if (err)
 		goto out;
@@ -0,0 +1,361 @@
+/**
+ * @file shard.c  SIP Stack Shards
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_sa.h>
+#include <re_list.h>
+#include <re_hash.h>
+#include <re_fmt.h>
+#include <re_uri.h>
+#include <re_udp.h>
+#include <re_lock.h>
+#include <re_mqueue.h>
+#include <re_msg.h>
+#include <re_sip.h>
+#include "sip.h"
+
+
+#define DEBUG_MODULE "shard"
+#define DEBUG_LEVEL 5
+#include <re_dbg.h>
+
+
+/*
+ * A group of SIP stacks, each one running in its own thread with its own
+ * re_main() loop. The UDP transports of all shards share their local
+ * ports and the kernel spreads the datagrams across them. A shard hands
+ * over the messages it does not own to the owning shard:
+ *
+ *   requests  - by the hash of the Call-ID
+ *   responses - by the shard index in the top byte of the Via branch
+ *
+ * TCP and TLS messages stay with the shard which accepted the
+ * connection, since the replies must be sent on that connection.
+ */
+
+
+enum {
+	SHARDS_MAX = 256,
+};
+
+
+/** Defines a group of SIP stack shards */
+struct sip_shards {
+	struct lock *lock;          /**< Protects the shard vector        */
+	struct sip_shard **shardv;  /**< Attached shards by index         */
+	uint32_t n;                 /**< Number of shards                 */
+};
+
+/** Defines one SIP stack shard */
+struct sip_shard {
+	struct sip_shards *grp;     /**< Shard group                      */
+	struct mqueue *mq;          /**< Messages from the other shards   */
+	struct lock *lock;          /**< Protects the queued messages     */
+	struct list fwdl;           /**< Queued messages                  */
+	struct sip *sip;            /**< SIP stack of this shard          */
+	uint32_t idx;               /**< Shard index                      */
+	uint32_t fwd_out;           /**< Messages handed to other shards  */
+	uint32_t fwd_in;            /**< Messages from other shards       */
+	uint32_t fwd_drop;          /**< Messages without a transport     */
+};
+
+/** A message handed over to another shard */
+struct fwd {
+	struct le le;
+	struct mbuf *mb;
+	struct sa src;
+	struct sa dst;
+};
+
+
+static void grp_destructor(void *arg)
+{
+	struct sip_shards *grp = arg;
+
+	mem_deref(grp->shardv);
+	mem_deref(grp->lock);
+}
+
+
+static void shard_destructor(void *arg)
+{
+	struct sip_shard *sh = arg;
+
+	lock_write_get(sh->grp->lock);
+	if (sh->grp->shardv[sh->idx] == sh)
+		sh->grp->shardv[sh->idx] = NULL;
+	lock_rel(sh->grp->lock);
+
+	/* the queue holds the only reference to the pending messages */
+	if (sh->lock) {
+		lock_write_get(sh->lock);
+		list_flush(&sh->fwdl);
+		lock_rel(sh->lock);
+	}
+
+	mem_deref(sh->mq);
+	mem_deref(sh->lock);
+}
+
+
+static void fwd_destructor(void *arg)
+{
+	struct fwd *fwd = arg;
+
+	mem_deref(fwd->mb);
+}
+
+
+static void mqueue_handler(int id, void *data, void *arg)
+{
+	struct sip_shard *sh = arg;
+	struct fwd *fwd = data;
+	(void)id;
+
+	lock_write_get(sh->lock);
+	list_unlink(&fwd->le);
+	lock_rel(sh->lock);
+
+	++sh->fwd_in;
+
+	/* the shards must have the same UDP transports */
+	if (sip_transp_udp_recv(sh->sip, &fwd->src, &fwd->dst, fwd->mb)) {
+		++sh->fwd_drop;
+		DEBUG_WARNING("shard %u: no UDP transport on %J,"
+			      " message from %J dropped\n",
+			      sh->idx, &fwd->dst, &fwd->src);
+	}
+
+	mem_deref(fwd);
+}
+
+
+static uint32_t route(const struct sip_shard *sh, const struct sip_msg *msg)
+{
+	struct pl pl;
+	uint32_t idx;
+
+	if (msg->req)
+		return hash_joaat_pl(&msg->callid) % sh->grp->n;
+
+	if (msg->via.branch.l != 23 ||
+	    memcmp(msg->via.branch.p, "z9hG4bK", 7))
+		return sh->idx;
+
+	pl.p = msg->via.branch.p + 7;
+	pl.l = 2;
+
+	idx = pl_x32(&pl);
+
+	return idx < sh->grp->n ? idx : sh->idx;
+}
+
+
+/**
+ * Allocate a group of SIP stack shards
+ *
+ * @param grpp Pointer to allocated shard group
+ * @param n    Number of shards
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note The group must outlive the SIP stacks attached to it
+ */
+int sip_shards_alloc(struct sip_shards **grpp, uint32_t n)
+{
+	struct sip_shards *grp;
+	int err;
+
+	if (!grpp || !n || n > SHARDS_MAX)
+		return EINVAL;
+
+	grp = mem_zalloc(sizeof(*grp), grp_destructor);
+	if (!grp)
+		return ENOMEM;
+
+	grp->n = n;
+
+	grp->shardv = mem_zalloc(n * sizeof(*grp->shardv), NULL);
+	if (!grp->shardv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = lock_alloc(&grp->lock);
+
+ out:
+	if (err)
+		mem_deref(grp);
+	else
+		*grpp = grp;
+
+	return err;
+}
+
+
+/**
+ * Attach a SIP stack to a shard group. Must be called from the thread
+ * running the SIP stack, before adding any transports. All the shards
+ * must add the same UDP transports, with the port set.
+ *
+ * @param sip SIP stack instance
+ * @param grp Shard group
+ * @param idx Shard index
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note Requests are owned by the shard selected by their Call-ID, the
+ *       dialogs created by this stack must be allocated with
+ *       sip_dialog_alloc_shard()
+ */
+int sip_shard_attach(struct sip *sip, struct sip_shards *grp, uint32_t idx)
+{
+	struct sip_shard *sh;
+	int err;
+
+	if (!sip || !grp || idx >= grp->n)
+		return EINVAL;
+
+	if (sip->shard)
+		return EALREADY;
+
+	if (!list_isempty(&sip->transpl))
+		return EBUSY;
+
+	sh = mem_zalloc(sizeof(*sh), shard_destructor);
+	if (!sh)
+		return ENOMEM;
+
+	sh->grp = grp;
+	sh->sip = sip;
+	sh->idx = idx;
+
+	err = lock_alloc(&sh->lock);
+	if (err)
+		goto out;
+
+	err = mqueue_alloc(&sh->mq, mqueue_handler, sh);
+	if (err)
+		goto out;
+
+	lock_write_get(grp->lock);
+
+	if (grp->shardv[idx])
+		err = EADDRINUSE;
+	else
+		grp->shardv[idx] = sh;
+
+	lock_rel(grp->lock);
+
+ out:
+	if (err)
+		mem_deref(sh);
+	else
+		sip->shard = sh;
+
+	return err;
+}
+
+
+/**
+ * Check if a Call-ID is owned by the shard of a SIP stack
+ *
+ * @param sip    SIP stack instance
+ * @param callid Call-ID
+ *
+ * @return True if owned by this shard or not sharded, otherwise false
+ */
+bool sip_shard_owns(const struct sip *sip, const struct pl *callid)
+{
+	if (!sip || !callid)
+		return false;
+
+	if (!sip->shard)
+		return true;
+
+	return hash_joaat_pl(callid) % sip->shard->grp->n == sip->shard->idx;
+}
+
+
+/* Put the shard index in the top byte of a random branch value */
+uint64_t sip_shard_branch(const struct sip *sip, uint64_t rnd)
+{
+	if (!sip->shard)
+		return rnd;
+
+	return (rnd & 0x00ffffffffffffffULL) | (uint64_t)sip->shard->idx << 56;
+}
+
+
+bool sip_shard_forward(struct sip *sip, const struct sip_msg *msg,
+		       const struct sa *src, const struct sa *dst,
+		       const uint8_t *buf, size_t len)
+{
+	struct sip_shard *sh = sip->shard, *tgt;
+	struct fwd *fwd;
+	uint32_t idx;
+	int err = ENOENT;
+
+	idx = route(sh, msg);
+	if (idx == sh->idx)
+		return false;
+
+	fwd = mem_zalloc(sizeof(*fwd), fwd_destructor);
+	if (!fwd)
+		return false;
+
+	fwd->mb = mbuf_alloc(len);
+	if (!fwd->mb || mbuf_write_mem(fwd->mb, buf, len)) {
+		mem_deref(fwd);
+		return false;
+	}
+
+	fwd->mb->pos = 0;
+	fwd->src = *src;
+	fwd->dst = *dst;
+
+	lock_read_get(sh->grp->lock);
+
+	tgt = sh->grp->shardv[idx];
+	if (tgt) {
+		lock_write_get(tgt->lock);
+
+		list_append(&tgt->fwdl, &fwd->le, fwd);
+
+		err = mqueue_push(tgt->mq, 0, fwd);
+		if (err)
+			list_unlink(&fwd->le);
+
+		lock_rel(tgt->lock);
+	}
+
+	lock_rel(sh->grp->lock);
+
+	/* a detached shard leaves its messages to the receiving shard */
+	if (err) {
+		mem_deref(fwd);
+		return false;
+	}
+
+	++sh->fwd_out;
+
+	return true;
+}
+
+
+int sip_shard_debug(struct re_printf *pf, const struct sip *sip)
+{
+	const struct sip_shard *sh = sip->shard;
+
+	if (!sh)
+		return 0;
+
+	return re_hprintf(pf, "shard: %u/%u (forwarded out=%u in=%u"
+			  " dropped=%u)\n", sh->idx, sh->grp->n,
+			  sh->fwd_out, sh->fwd_in, sh->fwd_drop);
+}
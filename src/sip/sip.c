@@ -34,6 +34,7 @@ static void destructor(void *arg)
 
 	sip_request_close(sip);
 	sip_request_close(sip);
+	mem_deref(sip->shard);
 
 	hash_flush(sip->ht_ctrans);
 	mem_deref(sip->ht_ctrans);
@@ -50,22 +51,13 @@ static void destructor(void *arg)
 	mem_deref(sip->ht_udpconn);
 
 	list_flush(&sip->transpl);
-	list_flush(&sip->lsnrl);
+	sip_lsnr_close(sip);
 
 	mem_deref(sip->software);
+	mem_deref(sip->rtmpl);
 	mem_deref(sip->dnsc);
 	mem_deref(sip->stun);
-}
-
-
-static void lsnr_destructor(void *arg)
-{
-	struct sip_lsnr *lsnr = arg;
-
-	if (lsnr->lsnrp)
-		*lsnr->lsnrp = NULL;
-
-	list_unlink(&lsnr->le);
+	mem_deref(sip->oc);
 }
 
 
@@ -97,6 +89,10 @@ int sip_alloc(struct sip **sipp, struct dnsc *dnsc, uint32_t ctsz,
 	if (!sip)
 		return ENOMEM;
 
+	err = sip_lsnr_init(sip);
+	if (err)
+		goto out;
+
 	err = sip_transp_init(sip, tcsz);
 	if (err)
 		goto out;
@@ -123,6 +119,10 @@ int sip_alloc(struct sip **sipp, struct dnsc *dnsc, uint32_t ctsz,
 			goto out;
 	}
 
+	err = sip_reply_init(sip);
+	if (err)
+		goto out;
+
 	sip->dnsc  = mem_ref(dnsc);
 	sip->exith = exith;
 	sip->arg   = arg;
@@ -177,44 +177,6 @@ int sip_send(struct sip *sip, void *sock, enum sip_transp tp,
 }
 
 
-/**
- * Listen for incoming SIP Requests and SIP Responses
- *
- * @param lsnrp Pointer to allocated listener
- * @param sip   SIP stack instance
- * @param req   True for Request, false for Response
- * @param msgh  SIP message handler
- * @param arg   Handler argument
- *
- * @return 0 if success, otherwise errorcode
- */
-int sip_listen(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
-	       sip_msg_h *msgh, void *arg)
-{
-	struct sip_lsnr *lsnr;
-
-	if (!sip || !msgh)
-		return EINVAL;
-
-	lsnr = mem_zalloc(sizeof(*lsnr), lsnr_destructor);
-	if (!lsnr)
-		return ENOMEM;
-
-	list_append(&sip->lsnrl, &lsnr->le, lsnr);
-
-	lsnr->msgh = msgh;
-	lsnr->arg = arg;
-	lsnr->req = req;
-
-	if (lsnrp) {
-		lsnr->lsnrp = lsnrp;
-		*lsnrp = lsnr;
-	}
-
-	return 0;
-}
-
-
 /**
  * Print debug information about the SIP stack
  *
@@ -233,6 +195,9 @@ int sip_debug(struct re_printf *pf, const struct sip *sip)
 	err  = sip_transp_debug(pf, sip);
 	err |= sip_ctrans_debug(pf, sip);
 	err |= sip_strans_debug(pf, sip);
+	err |= sip_lsnr_debug(pf, sip);
+	err |= sip_overload_debug(pf, sip);
+	err |= sip_shard_debug(pf, sip);
 
 	return err;
 }
@@ -8,26 +8,49 @@
 struct sip {
 	struct list transpl;
 	struct list lsnrl;
+	struct list lsnrl_req;
+	struct list lsnrl_resp;
 	struct list reql;
 	struct hash *ht_ctrans;
 	struct hash *ht_strans;
 	struct hash *ht_strans_mrg;
 	struct hash *ht_conn;
 	struct hash *ht_udpconn;
+	struct hash *ht_lsnr;
+	struct hash *ht_dlgc;
+	struct sip_lsnr *lsnr_cur;
+	struct dlgc *dlgc_cur;
 	struct dnsc *dnsc;
 	struct stun *stun;
+	struct sip_overload *oc;
+	struct sip_shard *shard;
 	char *software;
+	char *rtmpl;
+	size_t rtmpl_len;
 	sip_exit_h *exith;
 	void *arg;
+	uint32_t stransc;
+	uint32_t lsnr_seq;
+	uint32_t dlgc_cnt;
+	uint32_t dlgc_max;
+	uint32_t retx_absorbed;
+	uint32_t retx_resent;
 	bool closing;
 };
 
 
 struct sip_lsnr {
 	struct le le;
+	struct le ile;
+	struct list dlgcl;
 	struct sip_lsnr **lsnrp;
+	struct sip *sip;
 	sip_msg_h *msgh;
 	void *arg;
+	char *met;
+	uint32_t seq;
+	uint32_t hits;
+	uint32_t cache_hits;
 	bool req;
 };
 
@@ -40,10 +63,34 @@ struct sip_keepalive {
 };
 
 
+/* lsnr */
+int  sip_lsnr_init(struct sip *sip);
+void sip_lsnr_close(struct sip *sip);
+bool sip_lsnr_recv(struct sip *sip, const struct sip_msg *msg);
+int  sip_lsnr_debug(struct re_printf *pf, const struct sip *sip);
+
+
+/* overload */
+bool sip_overload_shed(struct sip *sip, const struct sip_msg *msg);
+int  sip_overload_debug(struct re_printf *pf, const struct sip *sip);
+
+
+/* shard */
+uint64_t sip_shard_branch(const struct sip *sip, uint64_t rnd);
+bool sip_shard_forward(struct sip *sip, const struct sip_msg *msg,
+		       const struct sa *src, const struct sa *dst,
+		       const uint8_t *buf, size_t len);
+int  sip_shard_debug(struct re_printf *pf, const struct sip *sip);
+
+
 /* request */
 void sip_request_close(struct sip *sip);
 
 
+/* reply */
+int  sip_reply_init(struct sip *sip);
+
+
 /* ctrans */
 struct sip_ctrans;
 
@@ -58,6 +105,8 @@ int  sip_ctrans_debug(struct re_printf *pf, const struct sip *sip);
 
 /* strans */
 int  sip_strans_init(struct sip *sip, uint32_t sz);
+bool sip_strans_absorb(struct sip *sip, const struct mbuf *mb);
+bool sip_strans_exists(const struct sip *sip, const struct sip_msg *msg);
 int  sip_strans_debug(struct re_printf *pf, const struct sip *sip);
 
 
@@ -67,6 +116,8 @@ struct sip_connqent;
 typedef void(sip_transp_h)(int err, void *arg);
 
 int  sip_transp_init(struct sip *sip, uint32_t sz);
+int  sip_transp_udp_recv(struct sip *sip, const struct sa *src,
+			 const struct sa *dst, struct mbuf *mb);
 int  sip_transp_send(struct sip_connqent **qentp, struct sip *sip, void *sock,
 		     enum sip_transp tp, const struct sa *dst, struct mbuf *mb,
 		     sip_transp_h *transph, void *arg);
@@ -81,6 +132,13 @@ int  sip_auth_encode(struct mbuf *mb, struct sip_auth *auth, const char *met,
 		     const char *uri);
 
 
+/* decoders */
+void sip_regex_init(void);
+void sip_addr_regex_compile(void);
+void sip_cseq_regex_compile(void);
+void sip_via_regex_compile(void);
+
+
 /* dialog */
 int  sip_dialog_encode(struct mbuf *mb, struct sip_dialog *dlg, uint32_t cseq,
 		       const char *met);
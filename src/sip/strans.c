@@ -3,6 +3,7 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#include <string.h>
 #include <re_types.h>
 #include <re_mem.h>
 #include <re_mbuf.h>
@@ -55,6 +56,8 @@ static void destructor(void *arg)
 	tmr_cancel(&st->tmrg);
 	mem_deref(st->msg);
 	mem_deref(st->mb);
+
+	--st->sip->stransc;
 }
 
 
@@ -274,6 +277,154 @@ static bool request_handler(const struct sip_msg *msg, void *arg)
 }
 
 
+/* Check if a request belongs to an existing server transaction */
+bool sip_strans_exists(const struct sip *sip, const struct sip_msg *msg)
+{
+	return NULL != hash_lookup(sip->ht_strans,
+				   hash_joaat_pl(&msg->via.branch),
+				   cmp_handler, (void *)msg);
+}
+
+
+static inline bool is_ws(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+
+/*
+ * Find the top Via and the CSeq header values in a raw SIP request.
+ * Returns false for responses, folded headers or anything unusual, which
+ * are left to the full decoder.
+ */
+static bool raw_decode(struct pl *via, struct pl *cseq, const struct mbuf *mb)
+{
+	const char *p = (const char *)mbuf_buf(mb);
+	const char *end = p + mbuf_get_left(mb);
+	const char *eol;
+
+	if (end - p < 4 || !memcmp(p, "SIP/", 4))
+		return false;
+
+	via->p = cseq->p = NULL;
+
+	for (;;) {
+		struct pl name, val;
+		const char *colon;
+
+		eol = memchr(p, '\n', end - p);
+		if (!eol)
+			return false;
+
+		p = eol + 1;
+		eol = memchr(p, '\n', end - p);
+		if (!eol || eol == p)
+			return false;
+
+		/* the value continues on a folded line */
+		if (eol + 1 < end && is_ws(eol[1]))
+			return false;
+
+		if (eol[-1] == '\r')
+			--eol;
+
+		/* end of headers */
+		if (eol == p)
+			return false;
+
+		if (is_ws(*p))
+			return false;
+
+		colon = memchr(p, ':', eol - p);
+		if (!colon)
+			return false;
+
+		name.p = p;
+		name.l = colon - p;
+		while (name.l && is_ws(name.p[name.l - 1]))
+			--name.l;
+
+		val.p = colon + 1;
+		while (val.p < eol && is_ws(*val.p))
+			++val.p;
+		val.l = eol - val.p;
+
+		if (!via->p && (!pl_strcasecmp(&name, "Via") ||
+				!pl_strcasecmp(&name, "v"))) {
+			const char *comma = memchr(val.p, ',', val.l);
+			if (comma)
+				val.l = comma - val.p;
+			*via = val;
+		}
+		else if (!cseq->p && !pl_strcasecmp(&name, "CSeq")) {
+			*cseq = val;
+		}
+
+		if (via->p && cseq->p)
+			return true;
+	}
+}
+
+
+/**
+ * Absorb a retransmitted request, without decoding the whole message.
+ * The last response of the matching server transaction is sent again.
+ *
+ * @param sip SIP Stack instance
+ * @param mb  Buffer containing the raw SIP message
+ *
+ * @return True if the request was absorbed, otherwise false
+ */
+bool sip_strans_absorb(struct sip *sip, const struct mbuf *mb)
+{
+	struct sip_strans *st;
+	struct sip_msg msg;
+	struct pl via, cseq;
+
+	if (!sip || !mb)
+		return false;
+
+	if (!raw_decode(&via, &cseq, mb))
+		return false;
+
+	memset(&msg, 0, sizeof(msg));
+
+	if (sip_cseq_decode(&msg.cseq, &cseq))
+		return false;
+
+	/* ACK and CANCEL have their own matching rules */
+	if (!pl_strcmp(&msg.cseq.met, "ACK") ||
+	    !pl_strcmp(&msg.cseq.met, "CANCEL"))
+		return false;
+
+	if (sip_via_decode(&msg.via, &via))
+		return false;
+
+	st = list_ledata(hash_lookup(sip->ht_strans,
+				     hash_joaat_pl(&msg.via.branch),
+				     cmp_handler, &msg));
+	if (!st)
+		return false;
+
+	++sip->retx_absorbed;
+
+	switch (st->state) {
+
+	case PROCEEDING:
+	case COMPLETED:
+		(void)sip_send(st->sip, st->msg->sock, st->msg->tp,
+			       &st->dst, st->mb);
+		++sip->retx_resent;
+		break;
+
+	default:
+		break;
+	}
+
+	return true;
+}
+
+
 /**
  * Allocate a SIP Server Transaction
  *
@@ -311,6 +462,8 @@ int sip_strans_alloc(struct sip_strans **stp, struct sip *sip,
 	st->arg     = arg;
 	st->sip     = sip;
 
+	++sip->stransc;
+
 	*stp = st;
 
 	return 0;
@@ -448,7 +601,9 @@ int sip_strans_debug(struct re_printf *pf, const struct sip *sip)
 {
 	int err;
 
-	err = re_hprintf(pf, "server transactions:\n");
+	err = re_hprintf(pf, "server transactions: (retransmissions"
+			 " absorbed=%u resent=%u)\n",
+			 sip->retx_absorbed, sip->retx_resent);
 	hash_apply(sip->ht_strans, debug_handler, pf);
 
 	return err;
@@ -234,19 +234,11 @@ static void conn_keepalive_handler(void *arg)
 
 static void sip_recv(struct sip *sip, const struct sip_msg *msg)
 {
-	struct le *le = sip->lsnrl.head;
-
-	while (le) {
-		struct sip_lsnr *lsnr = le->data;
-
-		le = le->next;
-
-		if (msg->req != lsnr->req)
-			continue;
+	if (sip_overload_shed(sip, msg))
+		return;
 
-		if (lsnr->msgh(msg, lsnr->arg))
-			return;
-	}
+	if (sip_lsnr_recv(sip, msg))
+		return;
 
 	if (msg->req) {
 		(void)re_fprintf(stderr, "unhandeled request from %J: %r %r\n",
@@ -267,13 +259,48 @@ static void sip_recv(struct sip *sip, const struct sip_msg *msg)
 }
 
 
+static void udp_sip_recv(const struct sip_transport *transp,
+			 const struct sa *src, struct mbuf *mb, bool fwd)
+{
+	struct sip *sip = transp->sip;
+	const size_t pos = mb->pos;
+	struct sip_msg *msg;
+	int err;
+
+	/* retransmissions are absorbed before the full decode */
+	if (sip_strans_absorb(sip, mb))
+		return;
+
+	err = sip_msg_decode(&msg, mb);
+	if (err) {
+		(void)re_fprintf(stderr, "sip: msg decode err: %m\n", err);
+		return;
+	}
+
+	/* messages owned by another shard are handed over undecoded */
+	if (sip->shard && !fwd &&
+	    sip_shard_forward(sip, msg, src, &transp->laddr,
+			      mb->buf + pos, mb->end - pos)) {
+		mem_deref(msg);
+		return;
+	}
+
+	msg->sock = mem_ref(transp->sock);
+	msg->src = *src;
+	msg->dst = transp->laddr;
+	msg->tp = SIP_TRANSP_UDP;
+
+	sip_recv(sip, msg);
+
+	mem_deref(msg);
+}
+
+
 static void udp_recv_handler(const struct sa *src, struct mbuf *mb, void *arg)
 {
 	struct sip_transport *transp = arg;
 	struct stun_unknown_attr ua;
 	struct stun_msg *stun_msg;
-	struct sip_msg *msg;
-	int err;
 
 	if (mb->end <= 4)
 		return;
@@ -306,20 +333,35 @@ static void udp_recv_handler(const struct sa *src, struct mbuf *mb, void *arg)
 		return;
 	}
 
-	err = sip_msg_decode(&msg, mb);
-	if (err) {
-		(void)re_fprintf(stderr, "sip: msg decode err: %m\n", err);
-		return;
+	udp_sip_recv(transp, src, mb, false);
+}
+
+
+int sip_transp_udp_recv(struct sip *sip, const struct sa *src,
+			const struct sa *dst, struct mbuf *mb)
+{
+	const struct sip_transport *transp = NULL;
+	struct le *le;
+
+	for (le = sip->transpl.head; le; le = le->next) {
+
+		const struct sip_transport *t = le->data;
+
+		if (t->tp != SIP_TRANSP_UDP)
+			continue;
+
+		if (sa_cmp(&t->laddr, dst, SA_ALL)) {
+			transp = t;
+			break;
+		}
 	}
 
-	msg->sock = mem_ref(transp->sock);
-	msg->src = *src;
-	msg->dst = transp->laddr;
-	msg->tp = SIP_TRANSP_UDP;
+	if (!transp)
+		return ENOENT;
 
-	sip_recv(transp->sip, msg);
+	udp_sip_recv(transp, src, mb, true);
 
-	mem_deref(msg);
+	return 0;
 }
 
 
@@ -639,6 +681,7 @@ int sip_transp_add(struct sip *sip, enum sip_transp tp,
 		   const struct sa *laddr, ...)
 {
 	struct sip_transport *transp;
+	struct udp_sock *us = NULL;
 	struct tls *tls;
 	va_list ap;
 	int err;
@@ -659,8 +702,14 @@ int sip_transp_add(struct sip *sip, enum sip_transp tp,
 	switch (tp) {
 
 	case SIP_TRANSP_UDP:
-		err = udp_listen((struct udp_sock **)&transp->sock, laddr,
-				 udp_recv_handler, transp);
+		if (sip->shard)
+			err = udp_listen_reuse(&us, laddr,
+					       udp_recv_handler, transp);
+		else
+			err = udp_listen(&us, laddr,
+					 udp_recv_handler, transp);
+
+		transp->sock = us;
 		if (err)
 			break;
 
@@ -9,21 +9,40 @@
 #include <re_uri.h>
 #include <re_list.h>
 #include <re_sa.h>
+#include <re_udp.h>
 #include <re_msg.h>
 #include <re_sip.h>
+#include "sip.h"
+
+
+static struct re_regex rx_hostport6 =
+	RE_REGEX_INIT("\\[[0-9a-f:]+\\][:]*[0-9]*");
+static struct re_regex rx_hostport =
+	RE_REGEX_INIT("[^:]+[:]*[0-9]*");
+static struct re_regex rx_via =
+	RE_REGEX_INIT("SIP[  \t\r\n]*/[ \t\r\n]*2.0[ \t\r\n]*/[ \t\r\n]*"
+		      "[A-Z]+[ \t\r\n]*[^; \t\r\n]+[ \t\r\n]*[^]*");
+
+
+void sip_via_regex_compile(void)
+{
+	(void)re_regex_compile(&rx_hostport6, rx_hostport6.expr);
+	(void)re_regex_compile(&rx_hostport, rx_hostport.expr);
+	(void)re_regex_compile(&rx_via, rx_via.expr);
+}
 
 
 static int decode_hostport(const struct pl *hostport, struct pl *host,
 			   struct pl *port)
 {
 	/* Try IPv6 first */
-	if (!re_regex(hostport->p, hostport->l, "\\[[0-9a-f:]+\\][:]*[0-9]*",
-		      host, NULL, port))
+	if (!re_regex_exec(&rx_hostport6, hostport->p, hostport->l,
+			   host, NULL, port))
 		return 0;
 
 	/* Then non-IPv6 host */
-	return re_regex(hostport->p, hostport->l, "[^:]+[:]*[0-9]*",
-			host, NULL, port);
+	return re_regex_exec(&rx_hostport, hostport->p, hostport->l,
+			     host, NULL, port);
 }
 
 
@@ -43,11 +62,11 @@ int sip_via_decode(struct sip_via *via, const struct pl *pl)
 	if (!via || !pl)
 		return EINVAL;
 
-	err = re_regex(pl->p, pl->l,
-		       "SIP[  \t\r\n]*/[ \t\r\n]*2.0[ \t\r\n]*/[ \t\r\n]*"
-		       "[A-Z]+[ \t\r\n]*[^; \t\r\n]+[ \t\r\n]*[^]*",
-		       NULL, NULL, NULL, NULL, &transp,
-		       NULL, &via->sentby, NULL, &via->params);
+	sip_regex_init();
+
+	err = re_regex_exec(&rx_via, pl->p, pl->l,
+			    NULL, NULL, NULL, NULL, &transp,
+			    NULL, &via->sentby, NULL, &via->params);
 	if (err)
 		return err;
 
@@ -28,7 +28,8 @@ static void destructor(void *arg)
 {
 	struct sipevent_sock *sock = arg;
 
-	mem_deref(sock->lsnr);
+	mem_deref(sock->lsnr_sub);
+	mem_deref(sock->lsnr_not);
 	hash_flush(sock->ht_not);
 	hash_flush(sock->ht_sub);
 	mem_deref(sock->ht_not);
@@ -331,7 +332,13 @@ int sipevent_listen(struct sipevent_sock **sockp, struct sip *sip,
 	if (!sock)
 		return ENOMEM;
 
-	err = sip_listen(&sock->lsnr, sip, true, request_handler, sock);
+	err = sip_listen_method(&sock->lsnr_sub, sip, true, "SUBSCRIBE",
+				request_handler, sock);
+	if (err)
+		goto out;
+
+	err = sip_listen_method(&sock->lsnr_not, sip, true, "NOTIFY",
+				request_handler, sock);
 	if (err)
 		goto out;
 
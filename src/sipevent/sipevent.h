@@ -7,7 +7,8 @@
 /* Listener Socket */
 
 struct sipevent_sock {
-	struct sip_lsnr *lsnr;
+	struct sip_lsnr *lsnr_sub;
+	struct sip_lsnr *lsnr_not;
 	struct hash *ht_not;
 	struct hash *ht_sub;
 	struct sip *sip;
@@ -381,8 +381,9 @@ static int sipsub_alloc(struct sipsub **subp, struct sipevent_sock *sock,
 		sub->dlg = mem_ref(dlg);
 	}
 	else {
-		err = sip_dialog_alloc(&sub->dlg, uri, uri, from_name,
-				       from_uri, routev, routec);
+		err = sip_dialog_alloc_shard(&sub->dlg, sock->sip, uri, uri,
+					     from_name, from_uri,
+					     routev, routec);
 		if (err)
 			goto out;
 	}
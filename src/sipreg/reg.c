@@ -342,8 +342,8 @@ int sipreg_register(struct sipreg **regp, struct sip *sip, const char *reg_uri,
 	if (!reg)
 		return ENOMEM;
 
-	err = sip_dialog_alloc(&reg->dlg, reg_uri, to_uri, from_name, from_uri,
-			       routev, routec);
+	err = sip_dialog_alloc_shard(&reg->dlg, sip, reg_uri, to_uri,
+				     from_name, from_uri, routev, routec);
 	if (err)
 		goto out;
 
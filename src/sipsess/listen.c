@@ -18,12 +18,26 @@
 #include "sipsess.h"
 
 
+/* a listener is allocated for each method, all entries must be set */
+static const char *req_methv[SIPSESS_METHODS] = {
+	"INVITE",
+	"ACK",
+	"BYE",
+	"INFO",
+	"REFER",
+};
+
+
 static void destructor(void *arg)
 {
 	struct sipsess_sock *sock = arg;
+	size_t i;
 
 	mem_deref(sock->lsnr_resp);
-	mem_deref(sock->lsnr_req);
+
+	for (i=0; i<ARRAY_SIZE(sock->lsnr_req); i++)
+		mem_deref(sock->lsnr_req[i]);
+
 	hash_flush(sock->ht_sess);
 	mem_deref(sock->ht_sess);
 	hash_flush(sock->ht_ack);
@@ -314,6 +328,7 @@ int sipsess_listen(struct sipsess_sock **sockp, struct sip *sip,
 		   int htsize, sipsess_conn_h *connh, void *arg)
 {
 	struct sipsess_sock *sock;
+	size_t i;
 	int err;
 
 	if (!sockp || !sip || !htsize)
@@ -323,13 +338,18 @@ int sipsess_listen(struct sipsess_sock **sockp, struct sip *sip,
 	if (!sock)
 		return ENOMEM;
 
-	err = sip_listen(&sock->lsnr_resp, sip, false, response_handler, sock);
+	err = sip_listen_method(&sock->lsnr_resp, sip, false, "INVITE",
+				response_handler, sock);
 	if (err)
 		goto out;
 
-	err = sip_listen(&sock->lsnr_req, sip, true, request_handler, sock);
-	if (err)
-		goto out;
+	for (i=0; i<ARRAY_SIZE(sock->lsnr_req); i++) {
+
+		err = sip_listen_method(&sock->lsnr_req[i], sip, true,
+					req_methv[i], request_handler, sock);
+		if (err)
+			goto out;
+	}
 
 	err = hash_alloc(&sock->ht_sess, htsize);
 	if (err)
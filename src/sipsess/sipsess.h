@@ -5,6 +5,11 @@
  */
 
 
+enum {
+	SIPSESS_METHODS = 5,  /**< Request methods with a listener */
+};
+
+
 struct sipsess {
 	struct le he;
 	struct tmr tmr;
@@ -43,7 +48,7 @@ struct sipsess {
 
 struct sipsess_sock {
 	struct sip_lsnr *lsnr_resp;
-	struct sip_lsnr *lsnr_req;
+	struct sip_lsnr *lsnr_req[SIPSESS_METHODS];
 	struct hash *ht_sess;
 	struct hash *ht_ack;
 	struct sip *sip;
@@ -16,3 +16,4 @@ SRCS	+= stun/rep.c
 SRCS	+= stun/req.c
 SRCS	+= stun/stun.c
 SRCS	+= stun/stunstr.c
+SRCS	+= stun/view.c
@@ -250,29 +250,12 @@ struct stun_attr *stun_msg_attr_apply(const struct stun_msg *msg,
 }
 
 
-/**
- * Encode a STUN message
- *
- * @param mb      Buffer to encode message into
- * @param method  STUN Method
- * @param class   STUN Method class
- * @param tid     Transaction ID
- * @param ec      STUN error code (optional)
- * @param key     Authentication key (optional)
- * @param keylen  Number of bytes in authentication key
- * @param fp      Use STUN Fingerprint attribute
- * @param padding Padding byte
- * @param attrc   Number of attributes to encode (variable arguments)
- * @param ap      Variable list of attribute-tuples
- *                Each attribute has 2 arguments, attribute type and value
- *
- * @return 0 if success, otherwise errorcode
- */
-int stun_msg_vencode(struct mbuf *mb, uint16_t method, uint8_t class,
-		     const uint8_t *tid, const struct stun_errcode *ec,
-		     const uint8_t *key, size_t keylen, bool fp,
-		     uint8_t padding, uint32_t attrc, va_list ap)
+static int msg_vencode(struct mbuf *mb, uint16_t method, uint8_t class,
+		       const uint8_t *tid, const struct stun_errcode *ec,
+		       const uint8_t *key, size_t keylen, struct hmac *hmac,
+		       bool fp, uint8_t padding, uint32_t attrc, va_list ap)
 {
+	const bool auth = key || hmac;
 	struct stun_hdr hdr;
 	size_t start;
 	int err = 0;
@@ -304,17 +287,21 @@ int stun_msg_vencode(struct mbuf *mb, uint16_t method, uint8_t class,
 	}
 
 	/* header */
-	hdr.len = mb->pos - start - STUN_HEADER_SIZE + (key ? MI_SIZE : 0);
+	hdr.len = mb->pos - start - STUN_HEADER_SIZE + (auth ? MI_SIZE : 0);
 	mb->pos = start;
 	err |= stun_hdr_encode(mb, &hdr);
-	mb->pos += hdr.len - (key ? MI_SIZE : 0);
+	mb->pos += hdr.len - (auth ? MI_SIZE : 0);
 
-	if (key) {
+	if (auth) {
 		uint8_t mi[20];
 
 		mb->pos = start;
-		hmac_sha1(key, keylen, mbuf_buf(mb), mbuf_get_left(mb),
-			  mi, sizeof(mi));
+		if (hmac)
+			err |= hmac_digest(hmac, mi, sizeof(mi), mbuf_buf(mb),
+					   mbuf_get_left(mb));
+		else
+			hmac_sha1(key, keylen, mbuf_buf(mb),
+				  mbuf_get_left(mb), mi, sizeof(mi));
 
 		mb->pos += STUN_HEADER_SIZE + hdr.len - MI_SIZE;
 		err |= stun_attr_encode(mb, STUN_ATTR_MSG_INTEGRITY, mi,
@@ -341,6 +328,61 @@ int stun_msg_vencode(struct mbuf *mb, uint16_t method, uint8_t class,
 }
 
 
+/**
+ * Encode a STUN message
+ *
+ * @param mb      Buffer to encode message into
+ * @param method  STUN Method
+ * @param class   STUN Method class
+ * @param tid     Transaction ID
+ * @param ec      STUN error code (optional)
+ * @param key     Authentication key (optional)
+ * @param keylen  Number of bytes in authentication key
+ * @param fp      Use STUN Fingerprint attribute
+ * @param padding Padding byte
+ * @param attrc   Number of attributes to encode (variable arguments)
+ * @param ap      Variable list of attribute-tuples
+ *                Each attribute has 2 arguments, attribute type and value
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int stun_msg_vencode(struct mbuf *mb, uint16_t method, uint8_t class,
+		     const uint8_t *tid, const struct stun_errcode *ec,
+		     const uint8_t *key, size_t keylen, bool fp,
+		     uint8_t padding, uint32_t attrc, va_list ap)
+{
+	return msg_vencode(mb, method, class, tid, ec, key, keylen, NULL,
+			   fp, padding, attrc, ap);
+}
+
+
+/**
+ * Encode a STUN message with a precomputed HMAC key
+ *
+ * @param mb      Buffer to encode message into
+ * @param method  STUN Method
+ * @param class   STUN Method class
+ * @param tid     Transaction ID
+ * @param ec      STUN error code (optional)
+ * @param hmac    HMAC-SHA1 of the authentication key (optional)
+ * @param fp      Use STUN Fingerprint attribute
+ * @param padding Padding byte
+ * @param attrc   Number of attributes to encode (variable arguments)
+ * @param ap      Variable list of attribute-tuples
+ *                Each attribute has 2 arguments, attribute type and value
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int stun_msg_vencode_hmac(struct mbuf *mb, uint16_t method, uint8_t class,
+			  const uint8_t *tid, const struct stun_errcode *ec,
+			  struct hmac *hmac, bool fp, uint8_t padding,
+			  uint32_t attrc, va_list ap)
+{
+	return msg_vencode(mb, method, class, tid, ec, NULL, 0, hmac,
+			   fp, padding, attrc, ap);
+}
+
+
 /**
  * Encode a STUN message
  *
@@ -377,19 +419,45 @@ int stun_msg_encode(struct mbuf *mb, uint16_t method, uint8_t class,
 
 
 /**
- * Verify the Message-Integrity of a STUN message
+ * Encode a STUN message with a precomputed HMAC key
  *
- * @param msg    STUN Message
- * @param key    Authentication key
- * @param keylen Number of bytes in authentication key
+ * @param mb      Buffer to encode message into
+ * @param method  STUN Method
+ * @param class   STUN Method class
+ * @param tid     Transaction ID
+ * @param ec      STUN error code (optional)
+ * @param hmac    HMAC-SHA1 of the authentication key (optional)
+ * @param fp      Use STUN Fingerprint attribute
+ * @param padding Padding byte
+ * @param attrc   Number of attributes to encode (variable arguments)
+ * @param ...     Variable list of attribute-tuples
+ *                Each attribute has 2 arguments, attribute type and value
  *
- * @return 0 if verified, otherwise errorcode
+ * @return 0 if success, otherwise errorcode
  */
-int stun_msg_chk_mi(const struct stun_msg *msg, const uint8_t *key,
-		    size_t keylen)
+int stun_msg_encode_hmac(struct mbuf *mb, uint16_t method, uint8_t class,
+			 const uint8_t *tid, const struct stun_errcode *ec,
+			 struct hmac *hmac, bool fp, uint8_t padding,
+			 uint32_t attrc, ...)
+{
+	va_list ap;
+	int err;
+
+	va_start(ap, attrc);
+	err = stun_msg_vencode_hmac(mb, method, class, tid, ec, hmac, fp,
+				    padding, attrc, ap);
+	va_end(ap);
+
+	return err;
+}
+
+
+static int chk_mi(const struct stun_msg *msg, const uint8_t *key,
+		  size_t keylen, struct hmac *hmac)
 {
-	uint8_t hmac[SHA_DIGEST_LENGTH];
+	uint8_t md[SHA_DIGEST_LENGTH];
 	struct stun_attr *mi, *fp;
+	int err = 0;
 
 	if (!msg)
 		return EINVAL;
@@ -407,9 +475,13 @@ int stun_msg_chk_mi(const struct stun_msg *msg, const uint8_t *key,
 		msg->mb->pos -= STUN_HEADER_SIZE;
 	}
 
-	hmac_sha1(key, keylen, mbuf_buf(msg->mb),
-		  STUN_HEADER_SIZE + msg->hdr.len - MI_SIZE,
-		  hmac, sizeof(hmac));
+	if (hmac)
+		err = hmac_digest(hmac, md, sizeof(md), mbuf_buf(msg->mb),
+				  STUN_HEADER_SIZE + msg->hdr.len - MI_SIZE);
+	else
+		hmac_sha1(key, keylen, mbuf_buf(msg->mb),
+			  STUN_HEADER_SIZE + msg->hdr.len - MI_SIZE,
+			  md, sizeof(md));
 
 	if (fp) {
 		((struct stun_msg *)msg)->hdr.len += FP_SIZE;
@@ -417,13 +489,50 @@ int stun_msg_chk_mi(const struct stun_msg *msg, const uint8_t *key,
 		msg->mb->pos -= STUN_HEADER_SIZE;
 	}
 
-	if (memcmp(mi->v.msg_integrity, hmac, SHA_DIGEST_LENGTH))
+	if (err)
+		return err;
+
+	if (memcmp(mi->v.msg_integrity, md, SHA_DIGEST_LENGTH))
 		return EBADMSG;
 
 	return 0;
 }
 
 
+/**
+ * Verify the Message-Integrity of a STUN message
+ *
+ * @param msg    STUN Message
+ * @param key    Authentication key
+ * @param keylen Number of bytes in authentication key
+ *
+ * @return 0 if verified, otherwise errorcode
+ */
+int stun_msg_chk_mi(const struct stun_msg *msg, const uint8_t *key,
+		    size_t keylen)
+{
+	return chk_mi(msg, key, keylen, NULL);
+}
+
+
+/**
+ * Verify the Message-Integrity of a STUN message with a precomputed
+ * HMAC key
+ *
+ * @param msg  STUN Message
+ * @param hmac HMAC-SHA1 of the authentication key
+ *
+ * @return 0 if verified, otherwise errorcode
+ */
+int stun_msg_chk_hmac(const struct stun_msg *msg, struct hmac *hmac)
+{
+	if (!hmac)
+		return EINVAL;
+
+	return chk_mi(msg, NULL, 0, hmac);
+}
+
+
 /**
  * Check the Fingerprint of a STUN message
  *
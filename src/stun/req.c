@@ -13,6 +13,51 @@
 #include "stun.h"
 
 
+/* Either the raw key or the precomputed HMAC is used for integrity */
+static int vrequest(struct stun_ctrans **ctp, struct stun *stun, int proto,
+		    void *sock, const struct sa *dst, size_t presz,
+		    uint16_t method, const uint8_t *key, size_t keylen,
+		    struct hmac *hmac, bool fp, stun_resp_h *resph, void *arg,
+		    uint32_t attrc, va_list ap)
+{
+	uint8_t tid[STUN_TID_SIZE];
+	struct mbuf *mb;
+	uint32_t i;
+	int err;
+
+	if (!stun)
+		return EINVAL;
+
+	mb = mbuf_alloc(512);
+	if (!mb)
+		return ENOMEM;
+
+	for (i=0; i<STUN_TID_SIZE; i++)
+		tid[i] = rand_u32();
+
+	mb->pos = presz;
+	if (hmac)
+		err = stun_msg_vencode_hmac(mb, method, STUN_CLASS_REQUEST,
+					    tid, NULL, hmac, fp, 0x00,
+					    attrc, ap);
+	else
+		err = stun_msg_vencode(mb, method, STUN_CLASS_REQUEST,
+				       tid, NULL, key, keylen, fp, 0x00,
+				       attrc, ap);
+	if (err)
+		goto out;
+
+	mb->pos = presz;
+	err = stun_ctrans_request(ctp, stun, proto, sock, dst, mb, tid, method,
+				  key, keylen, hmac, resph, arg);
+
+ out:
+	mem_deref(mb);
+
+	return err;
+}
+
+
 /**
  * Send a STUN request using a client transaction
  *
@@ -39,38 +84,50 @@ int stun_request(struct stun_ctrans **ctp, struct stun *stun, int proto,
 		 uint16_t method, const uint8_t *key, size_t keylen, bool fp,
 		 stun_resp_h *resph, void *arg, uint32_t attrc, ...)
 {
-	uint8_t tid[STUN_TID_SIZE];
-	struct mbuf *mb;
-	uint32_t i;
 	va_list ap;
 	int err;
 
-	if (!stun)
-		return EINVAL;
+	va_start(ap, attrc);
+	err = vrequest(ctp, stun, proto, sock, dst, presz, method,
+		       key, keylen, NULL, fp, resph, arg, attrc, ap);
+	va_end(ap);
 
-	mb = mbuf_alloc(512);
-	if (!mb)
-		return ENOMEM;
+	return err;
+}
 
-	for (i=0; i<STUN_TID_SIZE; i++)
-		tid[i] = rand_u32();
+
+/**
+ * Send a STUN request with a precomputed HMAC key
+ *
+ * @param ctp     Pointer to allocated client transaction (optional)
+ * @param stun    STUN Instance
+ * @param proto   Transport Protocol
+ * @param sock    Socket; UDP (struct udp_sock) or TCP (struct tcp_conn)
+ * @param dst     Destination network address
+ * @param presz   Number of bytes in preamble, if sending over TURN
+ * @param method  STUN Method
+ * @param hmac    HMAC-SHA1 of the authentication key (optional)
+ * @param fp      Use STUN Fingerprint attribute
+ * @param resph   Response handler
+ * @param arg     Response handler argument
+ * @param attrc   Number of attributes to encode (variable arguments)
+ * @param ...     Variable list of attribute-tuples
+ *                Each attribute has 2 arguments, attribute type and value
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int stun_request_hmac(struct stun_ctrans **ctp, struct stun *stun, int proto,
+		      void *sock, const struct sa *dst, size_t presz,
+		      uint16_t method, struct hmac *hmac, bool fp,
+		      stun_resp_h *resph, void *arg, uint32_t attrc, ...)
+{
+	va_list ap;
+	int err;
 
 	va_start(ap, attrc);
-	mb->pos = presz;
-	err = stun_msg_vencode(mb, method, STUN_CLASS_REQUEST,
-			       tid, NULL, key, keylen, fp, 0x00, attrc, ap);
+	err = vrequest(ctp, stun, proto, sock, dst, presz, method,
+		       NULL, 0, hmac, fp, resph, arg, attrc, ap);
 	va_end(ap);
-	if (err)
-		goto out;
-
-	mb->pos = presz;
-	err = stun_ctrans_request(ctp, stun, proto, sock, dst, mb, tid, method,
-				  key, keylen, resph, arg);
-	if (err)
-		goto out;
-
- out:
-	mem_deref(mb);
 
 	return err;
 }
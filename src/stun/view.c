@@ -0,0 +1,312 @@
+/**
+ * @file stun/view.c  STUN Binding message view
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_mbuf.h>
+#include <re_sa.h>
+#include <re_list.h>
+#include <re_sha.h>
+#include <re_hmac.h>
+#include <re_crc32.h>
+#include <re_stun.h>
+#include "stun.h"
+
+
+/*
+ * Binding requests and responses used for ICE connectivity checks and
+ * consent freshness have a small fixed set of attributes. The view
+ * decodes them without allocating anything, the attribute values point
+ * into the buffer holding the message.
+ */
+
+
+enum {
+	MI_SIZE = 24,
+	FP_SIZE = 8,
+	FP_XOR  = 0x5354554e,
+};
+
+
+static inline uint16_t rd16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+
+static inline uint32_t rd32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+		(uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+
+static inline uint64_t rd64(const uint8_t *p)
+{
+	return (uint64_t)rd32(p) << 32 | rd32(p + 4);
+}
+
+
+static int attr_decode(struct stun_view *v, uint16_t type,
+		       uint8_t *p, size_t len)
+{
+	struct mbuf mb;
+
+	switch (type) {
+
+	case STUN_ATTR_USERNAME:
+		if (!v->username) {
+			v->username = (const char *)p;
+			v->username_len = len;
+		}
+		break;
+
+	case STUN_ATTR_PRIORITY:
+		if (len != 4)
+			return EBADMSG;
+
+		v->priority = rd32(p);
+		v->prio = true;
+		break;
+
+	case STUN_ATTR_USE_CAND:
+		if (len)
+			return EBADMSG;
+
+		v->use_cand = true;
+		break;
+
+	case STUN_ATTR_CONTROLLED:
+	case STUN_ATTR_CONTROLLING:
+		if (len != 8)
+			return EBADMSG;
+
+		if (v->controlled || v->controlling)
+			break;
+
+		v->tiebrk      = rd64(p);
+		v->controlled  = (type == STUN_ATTR_CONTROLLED);
+		v->controlling = (type == STUN_ATTR_CONTROLLING);
+		break;
+
+	case STUN_ATTR_XOR_MAPPED_ADDR:
+		if (sa_isset(&v->mapped_addr, SA_ADDR))
+			break;
+
+		mb.buf  = p;
+		mb.size = len;
+		mb.pos  = 0;
+		mb.end  = len;
+
+		return stun_addr_decode(&mb, &v->mapped_addr, v->tid);
+
+	case STUN_ATTR_ERR_CODE:
+		if (len < 4)
+			return EBADMSG;
+
+		v->scode = (p[2] & 0x7) * 100 + p[3];
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Decode a STUN Binding message without allocating memory
+ *
+ * @param v  STUN view, set on return
+ * @param mb Buffer containing the raw STUN packet
+ *
+ * @return 0 if success, ENOTSUP if not a Binding message, otherwise
+ *         errorcode
+ *
+ * @note The view points into the buffer, which is not consumed
+ */
+int stun_view_decode(struct stun_view *v, struct mbuf *mb)
+{
+	size_t pos, end;
+	uint8_t *buf;
+	uint16_t type;
+
+	if (!v || !mb)
+		return EINVAL;
+
+	memset(v, 0, sizeof(*v));
+
+	if (mbuf_get_left(mb) < STUN_HEADER_SIZE)
+		return EBADMSG;
+
+	buf  = mbuf_buf(mb);
+	type = rd16(buf);
+
+	if (type & 0xc000)
+		return EBADMSG;
+
+	v->len = rd16(buf + 2);
+	end = STUN_HEADER_SIZE + (size_t)v->len;
+
+	if (v->len & 0x3 || mbuf_get_left(mb) < end)
+		return EBADMSG;
+
+	if (rd32(buf + 4) != STUN_MAGIC_COOKIE)
+		return EBADMSG;
+
+	if (STUN_METHOD(type) != STUN_METHOD_BINDING)
+		return ENOTSUP;
+
+	v->buf = buf;
+	v->cls = STUN_CLASS(type);
+	v->tid = buf + 8;
+
+	for (pos = STUN_HEADER_SIZE; pos + 4 <= end;) {
+
+		const uint16_t atype = rd16(buf + pos);
+		const size_t alen = rd16(buf + pos + 2);
+		uint8_t *p = buf + pos + 4;
+		int err;
+
+		if (pos + 4 + alen > end)
+			return EBADMSG;
+
+		switch (atype) {
+
+		case STUN_ATTR_MSG_INTEGRITY:
+			if (alen != 20)
+				return EBADMSG;
+
+			if (!v->mi && !v->fp) {
+				v->mi = p;
+				v->mi_pos = pos;
+			}
+			break;
+
+		case STUN_ATTR_FINGERPRINT:
+			if (alen != 4)
+				return EBADMSG;
+
+			if (!v->fp) {
+				v->fp = p;
+				v->fp_pos = pos;
+			}
+			break;
+
+		default:
+			/* attributes after the integrity are ignored */
+			if (v->mi || v->fp)
+				break;
+
+			err = attr_decode(v, atype, p, alen);
+			if (err)
+				return err;
+			break;
+		}
+
+		pos += 4 + ((alen + 3) & ~3);
+	}
+
+	return 0;
+}
+
+
+static int chk_mi(const struct stun_view *v, const uint8_t *key,
+		  size_t keylen, struct hmac *hmac)
+{
+	uint8_t md[SHA_DIGEST_LENGTH];
+	uint8_t len[2];
+	int err = 0;
+
+	if (!v || !v->buf)
+		return EINVAL;
+
+	if (!v->mi)
+		return EPROTO;
+
+	/* the length covers the message up to the MESSAGE-INTEGRITY */
+	memcpy(len, v->buf + 2, sizeof(len));
+	v->buf[2] = (uint8_t)((v->mi_pos + MI_SIZE - STUN_HEADER_SIZE) >> 8);
+	v->buf[3] = (uint8_t)((v->mi_pos + MI_SIZE - STUN_HEADER_SIZE));
+
+	if (hmac)
+		err = hmac_digest(hmac, md, sizeof(md), v->buf, v->mi_pos);
+	else
+		hmac_sha1(key, keylen, v->buf, v->mi_pos, md, sizeof(md));
+
+	memcpy(v->buf + 2, len, sizeof(len));
+
+	if (err)
+		return err;
+
+	if (memcmp(v->mi, md, SHA_DIGEST_LENGTH))
+		return EBADMSG;
+
+	return 0;
+}
+
+
+/**
+ * Check the MESSAGE-INTEGRITY of a STUN view
+ *
+ * @param v      STUN view
+ * @param key    Authentication key
+ * @param keylen Number of bytes in authentication key
+ *
+ * @return 0 if valid, EPROTO if missing, EBADMSG if invalid
+ */
+int stun_view_chk_mi(const struct stun_view *v, const uint8_t *key,
+		     size_t keylen)
+{
+	return chk_mi(v, key, keylen, NULL);
+}
+
+
+/**
+ * Check the MESSAGE-INTEGRITY of a STUN view with a precomputed HMAC key
+ *
+ * @param v    STUN view
+ * @param hmac HMAC-SHA1 of the authentication key
+ *
+ * @return 0 if valid, EPROTO if missing, EBADMSG if invalid
+ */
+int stun_view_chk_hmac(const struct stun_view *v, struct hmac *hmac)
+{
+	if (!hmac)
+		return EINVAL;
+
+	return chk_mi(v, NULL, 0, hmac);
+}
+
+
+/**
+ * Check the FINGERPRINT of a STUN view
+ *
+ * @param v STUN view
+ *
+ * @return 0 if valid, EPROTO if missing, EBADMSG if invalid
+ */
+int stun_view_chk_fingerprint(const struct stun_view *v)
+{
+	uint32_t fprnt;
+
+	if (!v || !v->buf)
+		return EINVAL;
+
+	if (!v->fp)
+		return EPROTO;
+
+	/* FINGERPRINT must be the last attribute */
+	if (v->fp_pos + FP_SIZE != STUN_HEADER_SIZE + (size_t)v->len)
+		return EBADMSG;
+
+	fprnt = (uint32_t)crc32(0, v->buf, (unsigned int)v->fp_pos) ^ FP_XOR;
+
+	if (fprnt != rd32(v->fp))
+		return EBADMSG;
+
+	return 0;
+}
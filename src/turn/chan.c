@@ -21,13 +21,18 @@ enum {
 	CHAN_LIFETIME = 600,
 	CHAN_REFRESH = 250,
 	CHAN_NUMB_MIN = 0x4000,
-	CHAN_NUMB_MAX = 0x7fff
+	CHAN_NUMB_MAX = 0x7fff,
+	HOT_MAX = 64,
+	HOT_WINDOW = 2000,
 };
 
 
 struct channels {
 	struct hash *ht_numb;
 	struct hash *ht_peer;
+	struct hash *ht_hot;
+	uint32_t nhot;
+	uint32_t threshold;
 	uint16_t nr;
 };
 
@@ -43,10 +48,23 @@ struct chan {
 	struct stun_ctrans *ct;
 	turnc_chan_h *ch;
 	void *arg;
+	bool autob;
+	bool bound;
+};
+
+
+/* Packet counter for a peer without a channel */
+struct hot {
+	struct le he;
+	struct sa peer;
+	uint64_t ts;
+	uint32_t n;
 };
 
 
 static int chanbind_request(struct chan *chan, bool reset_ls);
+static int chan_add(struct turnc *turnc, const struct sa *peer, bool autob,
+		    turnc_chan_h *ch, void *arg);
 
 
 static void channels_destructor(void *data)
@@ -55,9 +73,11 @@ static void channels_destructor(void *data)
 
 	/* flush from primary hash */
 	hash_flush(c->ht_numb);
+	hash_flush(c->ht_hot);
 
 	mem_deref(c->ht_numb);
 	mem_deref(c->ht_peer);
+	mem_deref(c->ht_hot);
 }
 
 
@@ -72,6 +92,14 @@ static void chan_destructor(void *data)
 }
 
 
+static void hot_destructor(void *data)
+{
+	struct hot *hot = data;
+
+	hash_unlink(&hot->he);
+}
+
+
 static bool numb_hash_cmp_handler(struct le *le, void *arg)
 {
 	const struct chan *chan = le->data;
@@ -89,15 +117,29 @@ static bool peer_hash_cmp_handler(struct le *le, void *arg)
 }
 
 
+static bool hot_hash_cmp_handler(struct le *le, void *arg)
+{
+	const struct hot *hot = le->data;
+
+	return sa_cmp(&hot->peer, arg, SA_ALL);
+}
+
+
 static void timeout(void *arg)
 {
 	struct chan *chan = arg;
 	int err;
 
 	err = chanbind_request(chan, true);
-	if (err)
+	if (err) {
+		chan->bound = false;
+
+		if (chan->autob)
+			return;
+
 		chan->turnc->th(err, 0, NULL, NULL, NULL, NULL,
 				chan->turnc->arg);
+	}
 }
 
 
@@ -113,6 +155,7 @@ static void chanbind_resp_handler(int err, uint16_t scode, const char *reason,
 
 	case 0:
 		tmr_start(&chan->tmr, CHAN_REFRESH * 1000, timeout, chan);
+		chan->bound = true;
 		if (chan->ch) {
 			chan->ch(chan->arg);
 			chan->ch  = NULL;
@@ -137,6 +180,14 @@ static void chanbind_resp_handler(int err, uint16_t scode, const char *reason,
 	}
 
  out:
+	chan->bound = false;
+
+	/* automatic channels fall back to Send indications, and are
+	   bound again with the same number when the peer gets busy,
+	   since the server may still hold the binding */
+	if (chan->autob)
+		return;
+
 	chan->turnc->th(err, scode, reason, NULL, NULL, msg, chan->turnc->arg);
 }
 
@@ -174,23 +225,160 @@ static int chanbind_request(struct chan *chan, bool reset_ls)
 int turnc_add_chan(struct turnc *turnc, const struct sa *peer,
 		   turnc_chan_h *ch, void *arg)
 {
+	if (!turnc || !peer)
+		return EINVAL;
+
+	return chan_add(turnc, peer, false, ch, arg);
+}
+
+
+/**
+ * Set the threshold for automatic TURN Channels
+ *
+ * When a peer without a channel has been sent the given number of
+ * packets within two seconds, a channel is bound for it and refreshed
+ * for the lifetime of the TURN Client. Packets to the peer are sent as
+ * Send indications until the channel has been bound. A channel that
+ * fails to bind or refresh keeps its number, and is bound again with
+ * it the next time the threshold is reached.
+ *
+ * @param turnc     TURN Client
+ * @param threshold Number of packets, or 0 to disable
+ */
+void turnc_set_autochan(struct turnc *turnc, uint32_t threshold)
+{
+	if (!turnc)
+		return;
+
+	turnc->chans->threshold = threshold;
+
+	if (!threshold) {
+		hash_flush(turnc->chans->ht_hot);
+		turnc->chans->nhot = 0;
+	}
+}
+
+
+/**
+ * Count a packet sent to a peer without a usable channel
+ *
+ * @param turnc TURN Client
+ * @param peer  Peer IP-address
+ */
+void turnc_chan_autobind(struct turnc *turnc, const struct sa *peer)
+{
+	struct channels *c;
 	struct chan *chan;
-	int err;
+	struct hot *hot;
+	uint64_t now;
 
 	if (!turnc || !peer)
-		return EINVAL;
+		return;
 
-	if (turnc->chans->nr >= CHAN_NUMB_MAX)
-		return ERANGE;
+	c = turnc->chans;
+	if (!c->threshold || sa_cmp(peer, &turnc->srv, SA_ALL))
+		return;
+
+	/* bound, or a binding is in progress */
+	chan = turnc_chan_find_peer(turnc, peer);
+	if (chan && (chan->bound || chan->ct))
+		return;
+
+	hot = list_ledata(hash_lookup(c->ht_hot, sa_hash(peer, SA_ALL),
+				      hot_hash_cmp_handler, (void *)peer));
+	if (!hot) {
+
+		/* keep the table small, it only holds the recent peers */
+		if (c->nhot >= HOT_MAX) {
+			hash_flush(c->ht_hot);
+			c->nhot = 0;
+		}
+
+		hot = mem_zalloc(sizeof(*hot), hot_destructor);
+		if (!hot)
+			return;
 
-	if (turnc_chan_find_peer(turnc, peer))
-		return 0;
+		hot->peer = *peer;
+
+		hash_append(c->ht_hot, sa_hash(peer, SA_ALL), &hot->he, hot);
+		++c->nhot;
+	}
+
+	now = tmr_jiffies();
+
+	if (now - hot->ts > HOT_WINDOW) {
+		hot->ts = now;
+		hot->n  = 0;
+	}
+
+	if (++hot->n < c->threshold)
+		return;
+
+	mem_deref(hot);
+	--c->nhot;
+
+	if (chan)
+		(void)chanbind_request(chan, true);
+	else
+		(void)chan_add(turnc, peer, true, NULL, NULL);
+}
+
+
+/* Channel numbers are taken in turn and skip those in use, so that the
+   number of a removed channel is only reused after all the others */
+static int numb_alloc(struct turnc *turnc, uint16_t *nrp)
+{
+	struct channels *c = turnc->chans;
+	uint32_t i;
+
+	for (i=CHAN_NUMB_MIN; i<=CHAN_NUMB_MAX; i++) {
+
+		uint16_t nr = c->nr;
+
+		c->nr = (nr < CHAN_NUMB_MAX) ? nr + 1 : CHAN_NUMB_MIN;
+
+		if (!turnc_chan_find_numb(turnc, nr)) {
+			*nrp = nr;
+			return 0;
+		}
+	}
+
+	return ERANGE;
+}
+
+
+static int chan_add(struct turnc *turnc, const struct sa *peer, bool autob,
+		    turnc_chan_h *ch, void *arg)
+{
+	struct chan *chan;
+	uint16_t nr;
+	int err;
+
+	chan = turnc_chan_find_peer(turnc, peer);
+	if (chan) {
+		if (autob || !chan->autob)
+			return 0;
+
+		/* an explicit channel takes over a failed automatic one */
+		chan->autob = false;
+		if (chan->bound || chan->ct)
+			return 0;
+
+		chan->ch = ch;
+		chan->arg = arg;
+
+		return chanbind_request(chan, true);
+	}
+
+	err = numb_alloc(turnc, &nr);
+	if (err)
+		return err;
 
 	chan = mem_zalloc(sizeof(*chan), chan_destructor);
 	if (!chan)
 		return ENOMEM;
 
-	chan->nr = turnc->chans->nr++;
+	chan->nr = nr;
 	chan->peer = *peer;
 
 	hash_append(turnc->chans->ht_numb, chan->nr, &chan->he_numb, chan);
@@ -201,6 +389,7 @@ int turnc_add_chan(struct turnc *turnc, const struct sa *peer,
 	chan->turnc = turnc;
 	chan->ch = ch;
 	chan->arg = arg;
+	chan->autob = autob;
 
 	err = chanbind_request(chan, true);
 	if (err)
@@ -230,6 +419,10 @@ int turnc_chan_hash_alloc(struct channels **cp, uint32_t bsize)
 	if (err)
 		goto out;
 
+	err = hash_alloc(&c->ht_hot, bsize);
+	if (err)
+		goto out;
+
 	c->nr = CHAN_NUMB_MIN;
 
  out:
@@ -276,6 +469,13 @@ const struct sa *turnc_chan_peer(const struct chan *chan)
 }
 
 
+/* Automatic channels are only used for sending once they are bound */
+bool turnc_chan_ready(const struct chan *chan)
+{
+	return chan && (chan->bound || !chan->autob);
+}
+
+
 int turnc_chan_hdr_encode(const struct chan_hdr *hdr, struct mbuf *mb)
 {
 	int err;
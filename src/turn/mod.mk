@@ -6,4 +6,6 @@
 
 SRCS	+= turn/chan.c
 SRCS	+= turn/perm.c
+SRCS	+= turn/relay.c
 SRCS	+= turn/turnc.c
+SRCS	+= turn/turns.c
@@ -0,0 +1,554 @@
+/**
+ * @file relay.c  TURN Server allocations and relaying
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_fmt.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_list.h>
+#include <re_hash.h>
+#include <re_tmr.h>
+#include <re_sa.h>
+#include <re_md5.h>
+#include <re_udp.h>
+#include <re_stun.h>
+#include <re_turn.h>
+#include "turns.h"
+
+
+#define DEBUG_MODULE "turns"
+#define DEBUG_LEVEL 5
+#include <re_dbg.h>
+
+
+/*
+ * Packets are relayed in the buffer they were received in. The relay
+ * sockets reserve headroom for a Data indication, so the ChannelData
+ * header or the indication can be written in front of the peer data.
+ */
+
+
+enum {
+	PERM_LIFETIME = 300,
+	CHAN_LIFETIME = 600,
+	PERM_MAX      = 256,
+	CHAN_MAX      = 256,
+	BUCKET_SIZE   = 8,
+	CHAN_HDR_SIZE = 4,
+	STUN_ATTR_ADDR4_SIZE = 8,
+	STUN_ATTR_ADDR6_SIZE = 20,
+	RELAY_PRESZ = STUN_HEADER_SIZE + STUN_ATTR_HEADER_SIZE * 2
+		      + STUN_ATTR_ADDR6_SIZE,
+};
+
+
+struct perm {
+	struct le he;
+	struct sa peer;
+	uint64_t expires;
+};
+
+struct chan {
+	struct le he_numb;
+	struct le he_peer;
+	struct sa peer;
+	uint64_t expires;
+	uint16_t nr;
+};
+
+
+static const uint8_t dataind_tid[STUN_TID_SIZE];
+
+
+static void perm_destructor(void *data)
+{
+	struct perm *perm = data;
+
+	hash_unlink(&perm->he);
+}
+
+
+static void chan_destructor(void *data)
+{
+	struct chan *chan = data;
+
+	hash_unlink(&chan->he_numb);
+	hash_unlink(&chan->he_peer);
+}
+
+
+static void destructor(void *data)
+{
+	struct allocation *al = data;
+
+	tmr_cancel(&al->tmr);
+	hash_unlink(&al->he);
+
+	hash_flush(al->perms);
+	hash_flush(al->chans_numb);
+
+	mem_deref(al->perms);
+	mem_deref(al->chans_numb);
+	mem_deref(al->chans_peer);
+	mem_deref(al->rus);
+	mem_deref(al->username);
+
+	if (al->ts)
+		--al->ts->allocc;
+}
+
+
+static bool cli_cmp_handler(struct le *le, void *arg)
+{
+	const struct allocation *al = le->data;
+
+	return sa_cmp(&al->cli, arg, SA_ALL);
+}
+
+
+static bool perm_cmp_handler(struct le *le, void *arg)
+{
+	const struct perm *perm = le->data;
+
+	return sa_cmp(&perm->peer, arg, SA_ADDR);
+}
+
+
+static bool numb_cmp_handler(struct le *le, void *arg)
+{
+	const struct chan *chan = le->data;
+	const uint16_t *nr = arg;
+
+	return chan->nr == *nr;
+}
+
+
+static bool peer_cmp_handler(struct le *le, void *arg)
+{
+	const struct chan *chan = le->data;
+
+	return sa_cmp(&chan->peer, arg, SA_ALL);
+}
+
+
+static bool perm_expired_handler(struct le *le, void *arg)
+{
+	struct perm *perm = le->data;
+	struct allocation *al = arg;
+
+	if (perm->expires <= tmr_jiffies()) {
+		mem_deref(perm);
+		--al->permc;
+	}
+
+	return false;
+}
+
+
+static bool chan_expired_handler(struct le *le, void *arg)
+{
+	struct chan *chan = le->data;
+	struct allocation *al = arg;
+
+	if (chan->expires <= tmr_jiffies()) {
+		mem_deref(chan);
+		--al->chanc;
+	}
+
+	return false;
+}
+
+
+static struct perm *perm_find(const struct allocation *al,
+			      const struct sa *peer)
+{
+	struct perm *perm;
+
+	perm = list_ledata(hash_lookup(al->perms, sa_hash(peer, SA_ADDR),
+				       perm_cmp_handler, (void *)peer));
+
+	return (perm && perm->expires > tmr_jiffies()) ? perm : NULL;
+}
+
+
+static struct chan *chan_find_numb(const struct allocation *al, uint16_t nr)
+{
+	return list_ledata(hash_lookup(al->chans_numb, nr,
+				       numb_cmp_handler, &nr));
+}
+
+
+static struct chan *chan_find_peer(const struct allocation *al,
+				   const struct sa *peer)
+{
+	return list_ledata(hash_lookup(al->chans_peer, sa_hash(peer, SA_ALL),
+				       peer_cmp_handler, (void *)peer));
+}
+
+
+static void timeout(void *arg)
+{
+	struct allocation *al = arg;
+
+	DEBUG_INFO("allocation %J expired (client=%J)\n", &al->rel, &al->cli);
+
+	mem_deref(al);
+}
+
+
+static inline size_t stun_indlen(const struct sa *sa)
+{
+	size_t len = STUN_HEADER_SIZE + STUN_ATTR_HEADER_SIZE * 2;
+
+	switch (sa_af(sa)) {
+
+	case AF_INET:
+		len += STUN_ATTR_ADDR4_SIZE;
+		break;
+
+#ifdef HAVE_INET6
+	case AF_INET6:
+		len += STUN_ATTR_ADDR6_SIZE;
+		break;
+#endif
+	}
+
+	return len;
+}
+
+
+/* Data from a peer, relayed to the client */
+static void relay_recv_handler(const struct sa *src, struct mbuf *mb,
+			       void *arg)
+{
+	struct allocation *al = arg;
+	struct turns *ts = al->ts;
+	struct chan *chan;
+	size_t pos, len;
+	int err;
+
+	if (!perm_find(al, src)) {
+		++ts->stat.n_drop;
+		return;
+	}
+
+	len  = mbuf_get_left(mb);
+	chan = chan_find_peer(al, src);
+
+	if (chan && chan->expires > tmr_jiffies()) {
+
+		if (mb->pos < CHAN_HDR_SIZE)
+			return;
+
+		mb->pos -= CHAN_HDR_SIZE;
+		pos = mb->pos;
+
+		err  = mbuf_write_u16(mb, htons(chan->nr));
+		err |= mbuf_write_u16(mb, htons((uint16_t)len));
+
+		mb->pos = pos;
+
+		++ts->stat.n_chandata;
+	}
+	else {
+		const size_t indlen = stun_indlen(src);
+
+		if (mb->pos < indlen)
+			return;
+
+		mb->pos -= indlen;
+		pos = mb->pos;
+
+		err = stun_msg_encode(mb, STUN_METHOD_DATA,
+				      STUN_CLASS_INDICATION, dataind_tid,
+				      NULL, NULL, 0, false, 0x00, 2,
+				      STUN_ATTR_XOR_PEER_ADDR, src,
+				      STUN_ATTR_DATA, mb);
+
+		mb->pos = pos;
+
+		++ts->stat.n_ind;
+	}
+
+	if (err)
+		return;
+
+	(void)udp_send(ts->us, &al->cli, mb);
+}
+
+
+/**
+ * Create a TURN Allocation with a new relay socket
+ *
+ * @param alp      Pointer to allocated allocation
+ * @param ts       TURN Server
+ * @param cli      Client address
+ * @param msg      Allocate request
+ * @param username Authenticated username (optional)
+ * @param key      Long-term credential key (optional)
+ * @param lifetime Lifetime in [seconds]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int turns_relay_alloc(struct allocation **alp, struct turns *ts,
+		      const struct sa *cli, const struct stun_msg *msg,
+		      const char *username, const uint8_t *key,
+		      uint32_t lifetime)
+{
+	struct allocation *al;
+	struct sa laddr;
+	int err;
+
+	if (!alp || !ts || !cli || !msg)
+		return EINVAL;
+
+	al = mem_zalloc(sizeof(*al), destructor);
+	if (!al)
+		return ENOMEM;
+
+	hash_append(ts->ht_alloc, sa_hash(cli, SA_ALL), &al->he, al);
+	++ts->allocc;
+
+	al->ts  = ts;
+	al->cli = *cli;
+	memcpy(al->tid, stun_msg_tid(msg), sizeof(al->tid));
+
+	if (key)
+		memcpy(al->key, key, sizeof(al->key));
+
+	if (username) {
+		err = str_dup(&al->username, username);
+		if (err)
+			goto out;
+	}
+
+	err  = hash_alloc(&al->perms, BUCKET_SIZE);
+	err |= hash_alloc(&al->chans_numb, BUCKET_SIZE);
+	err |= hash_alloc(&al->chans_peer, BUCKET_SIZE);
+	if (err)
+		goto out;
+
+	sa_cpy(&laddr, &ts->relay);
+	sa_set_port(&laddr, 0);
+
+	err = udp_listen(&al->rus, &laddr, relay_recv_handler, al);
+	if (err)
+		goto out;
+
+	udp_rxbuf_presz_set(al->rus, RELAY_PRESZ);
+
+	err = udp_local_get(al->rus, &al->rel);
+	if (err)
+		goto out;
+
+	tmr_start(&al->tmr, lifetime * 1000, timeout, al);
+
+	++ts->stat.n_alloc;
+
+ out:
+	if (err)
+		mem_deref(al);
+	else
+		*alp = al;
+
+	return err;
+}
+
+
+/**
+ * Find the TURN Allocation of a client
+ *
+ * @param ts  TURN Server
+ * @param cli Client address
+ *
+ * @return Allocation if found, otherwise NULL
+ */
+struct allocation *turns_relay_find(const struct turns *ts,
+				    const struct sa *cli)
+{
+	if (!ts || !cli)
+		return NULL;
+
+	return list_ledata(hash_lookup(ts->ht_alloc, sa_hash(cli, SA_ALL),
+				       cli_cmp_handler, (void *)cli));
+}
+
+
+/**
+ * Refresh a TURN Allocation
+ *
+ * @param al       TURN Allocation
+ * @param lifetime New lifetime in [seconds]
+ */
+void turns_relay_refresh(struct allocation *al, uint32_t lifetime)
+{
+	if (!al)
+		return;
+
+	tmr_start(&al->tmr, lifetime * 1000, timeout, al);
+}
+
+
+/**
+ * Install or refresh a permission for a peer
+ *
+ * @param al   TURN Allocation
+ * @param peer Peer address, the port is ignored
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int turns_relay_perm_add(struct allocation *al, const struct sa *peer)
+{
+	struct perm *perm;
+
+	if (!al || !peer)
+		return EINVAL;
+
+	perm = list_ledata(hash_lookup(al->perms, sa_hash(peer, SA_ADDR),
+				       perm_cmp_handler, (void *)peer));
+	if (!perm) {
+
+		if (al->permc >= PERM_MAX)
+			(void)hash_apply(al->perms, perm_expired_handler, al);
+
+		if (al->permc >= PERM_MAX)
+			return ENOSPC;
+
+		perm = mem_zalloc(sizeof(*perm), perm_destructor);
+		if (!perm)
+			return ENOMEM;
+
+		sa_cpy(&perm->peer, peer);
+		hash_append(al->perms, sa_hash(peer, SA_ADDR), &perm->he,
+			    perm);
+		++al->permc;
+	}
+
+	perm->expires = tmr_jiffies() + PERM_LIFETIME * 1000;
+
+	return 0;
+}
+
+
+/**
+ * Bind or refresh a channel, and the permission of its peer
+ *
+ * @param al   TURN Allocation
+ * @param nr   Channel number
+ * @param peer Peer address
+ *
+ * @return 0 if success, EADDRINUSE if the number or the peer is bound to
+ *         another channel, otherwise errorcode
+ */
+int turns_relay_chan_bind(struct allocation *al, uint16_t nr,
+			  const struct sa *peer)
+{
+	struct chan *chan, *pchan;
+	int err;
+
+	if (!al || !peer)
+		return EINVAL;
+
+	chan  = chan_find_numb(al, nr);
+	pchan = chan_find_peer(al, peer);
+
+	if (chan != pchan)
+		return EADDRINUSE;
+
+	if (!chan) {
+
+		if (al->chanc >= CHAN_MAX)
+			(void)hash_apply(al->chans_numb, chan_expired_handler,
+					 al);
+
+		if (al->chanc >= CHAN_MAX)
+			return ENOSPC;
+
+		chan = mem_zalloc(sizeof(*chan), chan_destructor);
+		if (!chan)
+			return ENOMEM;
+
+		chan->nr   = nr;
+		chan->peer = *peer;
+
+		hash_append(al->chans_numb, nr, &chan->he_numb, chan);
+		hash_append(al->chans_peer, sa_hash(peer, SA_ALL),
+			    &chan->he_peer, chan);
+		++al->chanc;
+	}
+
+	err = turns_relay_perm_add(al, peer);
+	if (err)
+		return err;
+
+	chan->expires = tmr_jiffies() + CHAN_LIFETIME * 1000;
+
+	return 0;
+}
+
+
+/**
+ * Relay the data of a Send indication to a peer
+ *
+ * @param al   TURN Allocation
+ * @param peer Peer address
+ * @param mb   Buffer positioned at the data
+ */
+void turns_relay_send(struct allocation *al, const struct sa *peer,
+		      struct mbuf *mb)
+{
+	if (!al || !peer || !mb)
+		return;
+
+	if (!perm_find(al, peer)) {
+		++al->ts->stat.n_drop;
+		return;
+	}
+
+	++al->ts->stat.n_ind;
+
+	(void)udp_send(al->rus, peer, mb);
+}
+
+
+/**
+ * Relay a ChannelData message from the client to the peer
+ *
+ * @param al TURN Allocation
+ * @param mb Buffer positioned at the ChannelData header
+ */
+void turns_relay_chan_send(struct allocation *al, struct mbuf *mb)
+{
+	struct chan *chan;
+	uint16_t nr, len;
+
+	if (!al || !mb)
+		return;
+
+	if (mbuf_get_left(mb) < CHAN_HDR_SIZE)
+		goto drop;
+
+	nr  = ntohs(mbuf_read_u16(mb));
+	len = ntohs(mbuf_read_u16(mb));
+
+	if (mbuf_get_left(mb) < len)
+		goto drop;
+
+	chan = chan_find_numb(al, nr);
+	if (!chan || chan->expires <= tmr_jiffies())
+		goto drop;
+
+	/* strip the padding */
+	mb->end = mb->pos + len;
+
+	++al->ts->stat.n_chandata;
+
+	(void)udp_send(al->rus, &chan->peer, mb);
+	return;
+
+ drop:
+	++al->ts->stat.n_drop;
+}
@@ -274,7 +274,7 @@ static bool udp_send_handler(int *err, struct sa *dst, struct mbuf *mb,
 		return false;
 
 	chan = turnc_chan_find_peer(turnc, dst);
-	if (chan) {
+	if (turnc_chan_ready(chan)) {
 		struct chan_hdr hdr;
 
 		hdr.nr  = turnc_chan_numb(chan);
@@ -289,6 +289,8 @@ static bool udp_send_handler(int *err, struct sa *dst, struct mbuf *mb,
 		return false;
 	}
 
+	turnc_chan_autobind(turnc, dst);
+
 	indlen = stun_indlen(dst);
 
 	if (mb->pos < indlen)
@@ -478,7 +480,7 @@ int turnc_send(struct turnc *turnc, const struct sa *dst, struct mbuf *mb)
 		return EINVAL;
 
 	chan = turnc_chan_find_peer(turnc, dst);
-	if (chan) {
+	if (turnc_chan_ready(chan)) {
 		struct chan_hdr hdr;
 
 		if (mb->pos < CHAN_HDR_SIZE)
@@ -509,6 +511,8 @@ int turnc_send(struct turnc *turnc, const struct sa *dst, struct mbuf *mb)
 		mb->pos = pos;
 	}
 	else {
+		turnc_chan_autobind(turnc, dst);
+
 		indlen = stun_indlen(dst);
 
 		if (mb->pos < indlen)
@@ -0,0 +1,594 @@
+/**
+ * @file turns.c  TURN Server implementation
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_fmt.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_list.h>
+#include <re_hash.h>
+#include <re_tmr.h>
+#include <re_sa.h>
+#include <re_md5.h>
+#include <re_sys.h>
+#include <re_udp.h>
+#include <re_stun.h>
+#include <re_turn.h>
+#include "turns.h"
+
+
+#define DEBUG_MODULE "turns"
+#define DEBUG_LEVEL 5
+#include <re_dbg.h>
+
+
+/*
+ * The TURN Server relays UDP for clients on UDP (RFC 5766). It runs
+ * in the thread of the main loop, with one socket for the clients and
+ * one relay socket per allocation. Since the transport protocol and
+ * the server address are the same for all clients, the 5-tuple of an
+ * allocation is identified by the client address alone.
+ */
+
+
+enum {
+	ALLOC_HASH_SIZE = 256,
+	ALLOC_MAX       = 4096,
+	NONCE_LIFETIME  = 3600,
+	CHAN_NUMB_MIN   = 0x4000,
+	CHAN_NUMB_MAX   = 0x7fff,
+	PROTO_UDP       = 17,
+};
+
+
+static void destructor(void *data)
+{
+	struct turns *ts = data;
+
+	tmr_cancel(&ts->tmr);
+	hash_flush(ts->ht_alloc);
+
+	mem_deref(ts->ht_alloc);
+	mem_deref(ts->us);
+	mem_deref(ts->realm);
+}
+
+
+static void nonce_renew(void *arg)
+{
+	struct turns *ts = arg;
+
+	rand_str(ts->nonce, sizeof(ts->nonce));
+
+	tmr_start(&ts->tmr, NONCE_LIFETIME * 1000, nonce_renew, ts);
+}
+
+
+static void ereply(struct turns *ts, const struct sa *src,
+		   const struct stun_msg *msg, uint16_t scode,
+		   const char *reason, const uint8_t *key)
+{
+	(void)stun_ereply(IPPROTO_UDP, ts->us, src, 0, msg, scode, reason,
+			  key, key ? MD5_SIZE : 0, false, 1,
+			  STUN_ATTR_SOFTWARE, stun_software);
+}
+
+
+static void auth_ereply(struct turns *ts, const struct sa *src,
+			const struct stun_msg *msg, uint16_t scode,
+			const char *reason)
+{
+	(void)stun_ereply(IPPROTO_UDP, ts->us, src, 0, msg, scode, reason,
+			  NULL, 0, false, 3,
+			  STUN_ATTR_REALM, ts->realm,
+			  STUN_ATTR_NONCE, ts->nonce,
+			  STUN_ATTR_SOFTWARE, stun_software);
+}
+
+
+/*
+ * Long-term credentials (RFC 5389 section 10.2.2)
+ *
+ * Returns false if the request was rejected with an error response.
+ */
+static bool authenticate(struct turns *ts, const struct sa *src,
+			 const struct stun_msg *msg, uint8_t *key,
+			 const char **username)
+{
+	struct stun_attr *mi, *user, *realm, *nonce;
+
+	*username = NULL;
+
+	if (!ts->authh)
+		return true;
+
+	mi    = stun_msg_attr(msg, STUN_ATTR_MSG_INTEGRITY);
+	user  = stun_msg_attr(msg, STUN_ATTR_USERNAME);
+	realm = stun_msg_attr(msg, STUN_ATTR_REALM);
+	nonce = stun_msg_attr(msg, STUN_ATTR_NONCE);
+
+	if (!mi) {
+		auth_ereply(ts, src, msg, 401, stun_reason_401);
+		return false;
+	}
+
+	if (!user || !realm || !nonce) {
+		ereply(ts, src, msg, 400, stun_reason_400, NULL);
+		return false;
+	}
+
+	if (str_cmp(nonce->v.nonce, ts->nonce)) {
+		auth_ereply(ts, src, msg, 438, stun_reason_438);
+		return false;
+	}
+
+	if (str_cmp(realm->v.realm, ts->realm) ||
+	    ts->authh(key, user->v.username, ts->realm, ts->arg) ||
+	    stun_msg_chk_mi(msg, key, MD5_SIZE)) {
+		auth_ereply(ts, src, msg, 401, stun_reason_401);
+		return false;
+	}
+
+	*username = user->v.username;
+
+	return true;
+}
+
+
+static void allocate_reply(struct turns *ts, const struct sa *src,
+			   const struct stun_msg *msg,
+			   const struct allocation *al, uint32_t lifetime)
+{
+	const uint8_t *key = ts->authh ? al->key : NULL;
+
+	(void)stun_reply(IPPROTO_UDP, ts->us, src, 0, msg,
+			 key, key ? MD5_SIZE : 0, false, 4,
+			 STUN_ATTR_XOR_RELAY_ADDR, &al->rel,
+			 STUN_ATTR_LIFETIME, &lifetime,
+			 STUN_ATTR_XOR_MAPPED_ADDR, src,
+			 STUN_ATTR_SOFTWARE, stun_software);
+}
+
+
+static uint32_t req_lifetime(const struct stun_msg *msg)
+{
+	struct stun_attr *ltm = stun_msg_attr(msg, STUN_ATTR_LIFETIME);
+	uint32_t lifetime;
+
+	if (!ltm)
+		return TURN_DEFAULT_LIFETIME;
+
+	lifetime = max(ltm->v.lifetime, TURN_DEFAULT_LIFETIME);
+
+	return min(lifetime, TURN_MAX_LIFETIME);
+}
+
+
+static void allocate_request(struct turns *ts, const struct sa *src,
+			     const struct stun_msg *msg,
+			     struct allocation *al)
+{
+	uint8_t key[MD5_SIZE];
+	const uint8_t *mikey;
+	const char *username;
+	struct stun_attr *rt;
+	uint32_t lifetime;
+	int err;
+
+	if (!authenticate(ts, src, msg, key, &username))
+		return;
+
+	mikey = ts->authh ? key : NULL;
+
+	/* retransmitted request */
+	if (al) {
+		if (!memcmp(al->tid, stun_msg_tid(msg), sizeof(al->tid)))
+			allocate_reply(ts, src, msg, al,
+				       (uint32_t)(tmr_get_expire(&al->tmr)
+						  / 1000));
+		else
+			ereply(ts, src, msg, 437, stun_reason_437, mikey);
+		return;
+	}
+
+	rt = stun_msg_attr(msg, STUN_ATTR_REQ_TRANSPORT);
+	if (!rt) {
+		ereply(ts, src, msg, 400, stun_reason_400, mikey);
+		return;
+	}
+
+	if (rt->v.req_transport != PROTO_UDP) {
+		ereply(ts, src, msg, 442, stun_reason_442, mikey);
+		return;
+	}
+
+	if (ts->allocc >= ALLOC_MAX) {
+		ereply(ts, src, msg, 486, stun_reason_486, mikey);
+		return;
+	}
+
+	lifetime = req_lifetime(msg);
+
+	err = turns_relay_alloc(&al, ts, src, msg, username, mikey,
+				lifetime);
+	if (err) {
+		DEBUG_WARNING("allocate: %J: %m\n", src, err);
+		ereply(ts, src, msg, 508, stun_reason_508, mikey);
+		return;
+	}
+
+	allocate_reply(ts, src, msg, al, lifetime);
+}
+
+
+/* Requests on an existing allocation */
+static bool alloc_auth(struct turns *ts, const struct sa *src,
+		       const struct stun_msg *msg, struct allocation *al)
+{
+	uint8_t key[MD5_SIZE];
+	const uint8_t *mikey;
+	const char *username;
+
+	if (!authenticate(ts, src, msg, key, &username))
+		return false;
+
+	mikey = ts->authh ? key : NULL;
+
+	if (!al) {
+		ereply(ts, src, msg, 437, stun_reason_437, mikey);
+		return false;
+	}
+
+	if (ts->authh && str_cmp(username, al->username)) {
+		ereply(ts, src, msg, 441, stun_reason_441, mikey);
+		return false;
+	}
+
+	return true;
+}
+
+
+static void success_reply(struct turns *ts, const struct sa *src,
+			  const struct stun_msg *msg,
+			  const struct allocation *al)
+{
+	const uint8_t *key = ts->authh ? al->key : NULL;
+
+	(void)stun_reply(IPPROTO_UDP, ts->us, src, 0, msg,
+			 key, key ? MD5_SIZE : 0, false, 1,
+			 STUN_ATTR_SOFTWARE, stun_software);
+}
+
+
+static void refresh_request(struct turns *ts, const struct sa *src,
+			    const struct stun_msg *msg,
+			    struct allocation *al)
+{
+	struct stun_attr *ltm;
+	uint32_t lifetime;
+
+	if (!alloc_auth(ts, src, msg, al))
+		return;
+
+	ltm = stun_msg_attr(msg, STUN_ATTR_LIFETIME);
+
+	lifetime = (ltm && !ltm->v.lifetime) ? 0 : req_lifetime(msg);
+
+	if (lifetime)
+		turns_relay_refresh(al, lifetime);
+
+	(void)stun_reply(IPPROTO_UDP, ts->us, src, 0, msg,
+			 ts->authh ? al->key : NULL,
+			 ts->authh ? MD5_SIZE : 0, false, 2,
+			 STUN_ATTR_LIFETIME, &lifetime,
+			 STUN_ATTR_SOFTWARE, stun_software);
+
+	if (!lifetime)
+		mem_deref(al);
+}
+
+
+static bool perm_handler(const struct stun_attr *attr, void *arg)
+{
+	struct allocation *al = arg;
+
+	if (attr->type != STUN_ATTR_XOR_PEER_ADDR)
+		return false;
+
+	return turns_relay_perm_add(al, &attr->v.xor_peer_addr) != 0;
+}
+
+
+static void createperm_request(struct turns *ts, const struct sa *src,
+			       const struct stun_msg *msg,
+			       struct allocation *al)
+{
+	const uint8_t *key;
+
+	if (!alloc_auth(ts, src, msg, al))
+		return;
+
+	key = ts->authh ? al->key : NULL;
+
+	if (!stun_msg_attr(msg, STUN_ATTR_XOR_PEER_ADDR)) {
+		ereply(ts, src, msg, 400, stun_reason_400, key);
+		return;
+	}
+
+	if (stun_msg_attr_apply(msg, perm_handler, al)) {
+		ereply(ts, src, msg, 508, stun_reason_508, key);
+		return;
+	}
+
+	success_reply(ts, src, msg, al);
+}
+
+
+static void chanbind_request(struct turns *ts, const struct sa *src,
+			     const struct stun_msg *msg,
+			     struct allocation *al)
+{
+	struct stun_attr *chnr, *peer;
+	const uint8_t *key;
+	int err;
+
+	if (!alloc_auth(ts, src, msg, al))
+		return;
+
+	key = ts->authh ? al->key : NULL;
+
+	chnr = stun_msg_attr(msg, STUN_ATTR_CHANNEL_NUMBER);
+	peer = stun_msg_attr(msg, STUN_ATTR_XOR_PEER_ADDR);
+	if (!chnr || !peer ||
+	    chnr->v.channel_number < CHAN_NUMB_MIN ||
+	    chnr->v.channel_number > CHAN_NUMB_MAX) {
+		ereply(ts, src, msg, 400, stun_reason_400, key);
+		return;
+	}
+
+	err = turns_relay_chan_bind(al, chnr->v.channel_number,
+				    &peer->v.xor_peer_addr);
+	switch (err) {
+
+	case 0:
+		success_reply(ts, src, msg, al);
+		break;
+
+	case EADDRINUSE:
+		ereply(ts, src, msg, 400, stun_reason_400, key);
+		break;
+
+	default:
+		ereply(ts, src, msg, 508, stun_reason_508, key);
+		break;
+	}
+}
+
+
+static void send_indication(struct turns *ts, const struct stun_msg *msg,
+			    struct mbuf *mb, struct allocation *al)
+{
+	struct stun_attr *peer, *data;
+
+	peer = stun_msg_attr(msg, STUN_ATTR_XOR_PEER_ADDR);
+	data = stun_msg_attr(msg, STUN_ATTR_DATA);
+	if (!al || !peer || !data) {
+		++ts->stat.n_drop;
+		return;
+	}
+
+	mb->pos = data->v.data.pos;
+	mb->end = data->v.data.end;
+
+	turns_relay_send(al, &peer->v.xor_peer_addr, mb);
+}
+
+
+static void stun_handler(struct turns *ts, const struct sa *src,
+			 struct stun_msg *msg, struct mbuf *mb,
+			 const struct stun_unknown_attr *ua)
+{
+	struct allocation *al = turns_relay_find(ts, src);
+
+	switch (stun_msg_class(msg)) {
+
+	case STUN_CLASS_REQUEST:
+		if (ua->typec > 0) {
+			(void)stun_ereply(IPPROTO_UDP, ts->us, src, 0, msg,
+					  420, stun_reason_420, NULL, 0,
+					  false, 1,
+					  STUN_ATTR_UNKNOWN_ATTR, ua);
+			break;
+		}
+
+		switch (stun_msg_method(msg)) {
+
+		case STUN_METHOD_BINDING:
+			(void)stun_reply(IPPROTO_UDP, ts->us, src, 0, msg,
+					 NULL, 0, false, 2,
+					 STUN_ATTR_XOR_MAPPED_ADDR, src,
+					 STUN_ATTR_SOFTWARE, stun_software);
+			break;
+
+		case STUN_METHOD_ALLOCATE:
+			allocate_request(ts, src, msg, al);
+			break;
+
+		case STUN_METHOD_REFRESH:
+			refresh_request(ts, src, msg, al);
+			break;
+
+		case STUN_METHOD_CREATEPERM:
+			createperm_request(ts, src, msg, al);
+			break;
+
+		case STUN_METHOD_CHANBIND:
+			chanbind_request(ts, src, msg, al);
+			break;
+
+		default:
+			ereply(ts, src, msg, 400, stun_reason_400, NULL);
+			break;
+		}
+		break;
+
+	case STUN_CLASS_INDICATION:
+		if (stun_msg_method(msg) == STUN_METHOD_SEND)
+			send_indication(ts, msg, mb, al);
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+static void udp_recv_handler(const struct sa *src, struct mbuf *mb,
+			     void *arg)
+{
+	struct turns *ts = arg;
+	struct stun_unknown_attr ua;
+	struct stun_msg *msg;
+
+	if (!mbuf_get_left(mb))
+		return;
+
+	/* ChannelData messages start with 0b01 */
+	if ((mbuf_buf(mb)[0] & 0xc0) == 0x40) {
+		turns_relay_chan_send(turns_relay_find(ts, src), mb);
+		return;
+	}
+
+	if (stun_msg_decode(&msg, mb, &ua))
+		return;
+
+	stun_handler(ts, src, msg, mb, &ua);
+
+	mem_deref(msg);
+}
+
+
+/**
+ * Allocate a TURN Server
+ *
+ * @param tsp   Pointer to allocated TURN Server
+ * @param laddr Local address for clients
+ * @param relay Relay IP-address (optional, default is the local address)
+ * @param realm Authentication realm
+ * @param authh Authentication handler (optional, NULL for no
+ *              authentication)
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int turns_alloc(struct turns **tsp, const struct sa *laddr,
+		const struct sa *relay, const char *realm,
+		turns_auth_h *authh, void *arg)
+{
+	struct turns *ts;
+	int err;
+
+	if (!tsp || !laddr || (authh && !realm))
+		return EINVAL;
+
+	ts = mem_zalloc(sizeof(*ts), destructor);
+	if (!ts)
+		return ENOMEM;
+
+	err = hash_alloc(&ts->ht_alloc, ALLOC_HASH_SIZE);
+	if (err)
+		goto out;
+
+	if (realm) {
+		err = str_dup(&ts->realm, realm);
+		if (err)
+			goto out;
+	}
+
+	err = udp_listen(&ts->us, laddr, udp_recv_handler, ts);
+	if (err)
+		goto out;
+
+	sa_cpy(&ts->relay, relay ? relay : laddr);
+
+	ts->authh = authh;
+	ts->arg   = arg;
+
+	tmr_init(&ts->tmr);
+	nonce_renew(ts);
+
+ out:
+	if (err)
+		mem_deref(ts);
+	else
+		*tsp = ts;
+
+	return err;
+}
+
+
+/**
+ * Get the local address of a TURN Server
+ *
+ * @param ts    TURN Server
+ * @param laddr Local address, set on return
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int turns_local_get(const struct turns *ts, struct sa *laddr)
+{
+	if (!ts)
+		return EINVAL;
+
+	return udp_local_get(ts->us, laddr);
+}
+
+
+/**
+ * Get the statistics of a TURN Server
+ *
+ * @param ts   TURN Server
+ * @param stat Pointer to statistics, set on return
+ */
+void turns_stats(const struct turns *ts, struct turns_stat *stat)
+{
+	if (!ts || !stat)
+		return;
+
+	*stat = ts->stat;
+}
+
+
+/**
+ * Print the TURN Server status
+ *
+ * @param pf Print function
+ * @param ts TURN Server
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int turns_debug(struct re_printf *pf, const struct turns *ts)
+{
+	struct sa laddr;
+	int err;
+
+	if (!ts)
+		return 0;
+
+	sa_init(&laddr, AF_UNSPEC);
+	(void)udp_local_get(ts->us, &laddr);
+
+	err  = re_hprintf(pf, "TURN Server %J (realm=%s)\n",
+			  &laddr, ts->realm);
+	err |= re_hprintf(pf, " allocations: %u (%llu created)\n",
+			  ts->allocc, ts->stat.n_alloc);
+	err |= re_hprintf(pf, " relayed:     %llu ChannelData,"
+			  " %llu indications, %llu dropped\n",
+			  ts->stat.n_chandata, ts->stat.n_ind,
+			  ts->stat.n_drop);
+
+	return err;
+}
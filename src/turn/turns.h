@@ -0,0 +1,59 @@
+/**
+ * @file turns.h  Internal TURN Server interface
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+
+
+enum {
+	TURNS_NONCE_SIZE = 16,
+};
+
+
+/** Defines a TURN Server */
+struct turns {
+	struct udp_sock *us;           /**< Server socket                   */
+	struct hash *ht_alloc;         /**< Allocations by 5-tuple          */
+	struct sa relay;               /**< Relay IP-address                */
+	struct tmr tmr;                /**< Nonce renewal timer             */
+	char nonce[TURNS_NONCE_SIZE+1];/**< Current NONCE value             */
+	char *realm;                   /**< Authentication realm            */
+	turns_auth_h *authh;           /**< Authentication handler          */
+	void *arg;                     /**< Handler argument                */
+	uint32_t allocc;               /**< Number of allocations           */
+	struct turns_stat stat;        /**< Server statistics               */
+};
+
+/** Defines a TURN Allocation */
+struct allocation {
+	struct le he;                  /**< Hash element in allocations     */
+	struct tmr tmr;                /**< Lifetime timer                  */
+	struct sa cli;                 /**< Client address                  */
+	struct sa rel;                 /**< Relayed transport address       */
+	struct udp_sock *rus;          /**< Relay socket                    */
+	struct turns *ts;              /**< TURN Server                     */
+	struct hash *perms;            /**< Permissions by peer IP-address  */
+	struct hash *chans_numb;       /**< Channels by number              */
+	struct hash *chans_peer;       /**< Channels by peer address        */
+	uint32_t permc;                /**< Number of permissions           */
+	uint32_t chanc;                /**< Number of channels              */
+	char *username;                /**< Authenticated username          */
+	uint8_t key[MD5_SIZE];         /**< Long-term credential key        */
+	uint8_t tid[STUN_TID_SIZE];    /**< Transaction ID of Allocate      */
+};
+
+
+/* Relay */
+int  turns_relay_alloc(struct allocation **alp, struct turns *ts,
+		       const struct sa *cli, const struct stun_msg *msg,
+		       const char *username, const uint8_t *key,
+		       uint32_t lifetime);
+struct allocation *turns_relay_find(const struct turns *ts,
+				    const struct sa *cli);
+void turns_relay_refresh(struct allocation *al, uint32_t lifetime);
+int  turns_relay_perm_add(struct allocation *al, const struct sa *peer);
+int  turns_relay_chan_bind(struct allocation *al, uint16_t nr,
+			   const struct sa *peer);
+void turns_relay_send(struct allocation *al, const struct sa *peer,
+		      struct mbuf *mb);
+void turns_relay_chan_send(struct allocation *al, struct mbuf *mb);
@@ -243,18 +243,8 @@ static void udp_read_handler6(int flags, void *arg)
 }
 
 
-/**
- * Create and listen on a UDP Socket
- *
- * @param usp   Pointer to returned UDP Socket
- * @param local Local network address
- * @param rh    Receive handler
- * @param arg   Handler argument
- *
- * @return 0 if success, otherwise errorcode
- */
-int udp_listen(struct udp_sock **usp, const struct sa *local,
-	       udp_recv_h *rh, void *arg)
+static int udp_alloc(struct udp_sock **usp, const struct sa *local,
+		     bool reuse, udp_recv_h *rh, void *arg)
 {
 	struct addrinfo hints, *res = NULL, *r;
 	struct udp_sock *us = NULL;
@@ -329,6 +319,14 @@ int udp_listen(struct udp_sock **usp, const struct sa *local,
 			continue;
 		}
 
+		if (reuse) {
+			err = net_sockopt_reuse_set(fd, true);
+			if (err) {
+				(void)close(fd);
+				continue;
+			}
+		}
+
 		if (bind(fd, r->ai_addr, SIZ_CAST r->ai_addrlen) < 0) {
 			err = errno;
 			DEBUG_INFO("listen: bind(): %m (%J)\n", err, local);
@@ -391,6 +389,46 @@ int udp_listen(struct udp_sock **usp, const struct sa *local,
 }
 
 
+/**
+ * Create and listen on a UDP Socket
+ *
+ * @param usp   Pointer to returned UDP Socket
+ * @param local Local network address
+ * @param rh    Receive handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int udp_listen(struct udp_sock **usp, const struct sa *local,
+	       udp_recv_h *rh, void *arg)
+{
+	return udp_alloc(usp, local, false, rh, arg);
+}
+
+
+/**
+ * Create and listen on a UDP Socket which shares its local address with
+ * other sockets. The kernel spreads the incoming datagrams across the
+ * sockets by their source address.
+ *
+ * @param usp   Pointer to returned UDP Socket
+ * @param local Local network address, the port must be set
+ * @param rh    Receive handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int udp_listen_reuse(struct udp_sock **usp, const struct sa *local,
+		     udp_recv_h *rh, void *arg)
+{
+	/* port 0 would give each socket its own ephemeral port */
+	if (!local || !sa_port(local))
+		return EINVAL;
+
+	return udp_alloc(usp, local, true, rh, arg);
+}
+
+
 /**
  * Connect a UDP Socket to a specific peer.
  * When connected, this UDP Socket will only receive data from that peer.
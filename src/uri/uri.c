@@ -4,6 +4,9 @@
  * Copyright (C) 2010 Creytiv.com
  */
 #include <string.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include <re_types.h>
 #include <re_fmt.h>
 #include <re_mem.h>
@@ -71,6 +74,46 @@ int uri_encode(struct re_printf *pf, const struct uri *uri)
 }
 
 
+static struct re_regex rx_hostport6 =
+	RE_REGEX_INIT("\\[[0-9a-f:]+\\][:]*[0-9]*");
+static struct re_regex rx_hostport =
+	RE_REGEX_INIT("[^:]+[:]*[0-9]*");
+static struct re_regex rx_uri_user =
+	RE_REGEX_INIT("[^:]+:[^@:]*[:]*[^@]*@[^;? ]+[^?]*[^]*");
+static struct re_regex rx_uri =
+	RE_REGEX_INIT("[^:]+:[^;? ]+[^?]*[^]*");
+
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t rx_once = PTHREAD_ONCE_INIT;
+#else
+static bool rx_done;
+#endif
+
+
+static void regex_compile(void)
+{
+	(void)re_regex_compile(&rx_hostport6, rx_hostport6.expr);
+	(void)re_regex_compile(&rx_hostport, rx_hostport.expr);
+	(void)re_regex_compile(&rx_uri_user, rx_uri_user.expr);
+	(void)re_regex_compile(&rx_uri, rx_uri.expr);
+}
+
+
+/* The patterns are shared by all threads and compiled on first use */
+static void regex_init(void)
+{
+#ifdef HAVE_PTHREAD
+	(void)pthread_once(&rx_once, regex_compile);
+#else
+	if (!rx_done) {
+		regex_compile();
+		rx_done = true;
+	}
+#endif
+}
+
+
 /**
  * Decode host-port portion of a URI (if present)
  *
@@ -86,14 +129,16 @@ int uri_decode_hostport(const struct pl *hostport, struct pl *host,
 	if (!hostport || !host || !port)
 		return EINVAL;
 
+	regex_init();
+
 	/* Try IPv6 first */
-	if (!re_regex(hostport->p, hostport->l, "\\[[0-9a-f:]+\\][:]*[0-9]*",
-		      host, NULL, port))
+	if (!re_regex_exec(&rx_hostport6, hostport->p, hostport->l,
+			   host, NULL, port))
 		return 0;
 
 	/* Then non-IPv6 host */
-	return re_regex(hostport->p, hostport->l, "[^:]+[:]*[0-9]*",
-			host, NULL, port);
+	return re_regex_exec(&rx_hostport, hostport->p, hostport->l,
+			     host, NULL, port);
 }
 
 
@@ -115,19 +160,21 @@ int uri_decode(struct uri *uri, const struct pl *pl)
 	if (!uri || !pl)
 		return EINVAL;
 
+	regex_init();
+
 	memset(uri, 0, sizeof(*uri));
-	if (0 == re_regex(pl->p, pl->l,
-			  "[^:]+:[^@:]*[:]*[^@]*@[^;? ]+[^?]*[^]*",
-			  &uri->scheme, &uri->user, NULL, &uri->password,
-			  &hostport, &uri->params, &uri->headers)) {
+	if (0 == re_regex_exec(&rx_uri_user, pl->p, pl->l,
+			       &uri->scheme, &uri->user, NULL, &uri->password,
+			       &hostport, &uri->params, &uri->headers)) {
 
 		if (0 == uri_decode_hostport(&hostport, &uri->host, &port))
 			goto out;
 	}
 
 	memset(uri, 0, sizeof(*uri));
-	err = re_regex(pl->p, pl->l, "[^:]+:[^;? ]+[^?]*[^]*",
-		       &uri->scheme, &hostport, &uri->params, &uri->headers);
+	err = re_regex_exec(&rx_uri, pl->p, pl->l,
+			    &uri->scheme, &hostport, &uri->params,
+			    &uri->headers);
 	if (0 == err) {
 		err = uri_decode_hostport(&hostport, &uri->host, &port);
 		if (0 == err)